@@ -0,0 +1,174 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "QuadTree.h"
+#include "SpatialHash.h"
+#include "SweepAndPrune.h"
+#include "LinearQuadTree.h"
+#include "AABBTree.h"
+
+#include <chrono>
+#include <random>
+
+/*
+ * Runs all broadphases on the same lobby: a few Balls from start mass up to several hundred
+ * units (same formula as Ball::setMass) moving over lots of small Food.
+ * Then on RecordedLobby.txt, the elements of a lobby bench run with 30 players for 150 s and
+ * more Food (max 3000), where some Balls have grown to over a hundred units.
+ * A distribution can also be passed as file with one "x y size moving" line per element.
+ */
+
+static const double WIDTH = 5000;
+static const size_t FOOD = 4000;
+static const size_t BALLS = 150;
+static const size_t TICKS = 300;
+static const double TICK_RATE = 30;
+
+class BenchNode : public QuadTreeNode {
+public:
+	Vector mDirection;
+	double mSpeed;
+	bool mMoving;
+
+	BenchNode(const Vector& mPosition, double mSize, bool mMoving) : QuadTreeNode(mPosition, mSize), mMoving(mMoving) {
+		setCollisionType(mMoving ? 0 : 1, mMoving ? ~0u : ~0u ^ 1u << 1);
+		//Larger Balls are slower
+		mSpeed = 150 * 15 / mSize;
+	}
+	void reset(const Vector& position) {
+		mPosition = position;
+		mDirection = Vector(1, 0);
+	}
+	void move(const Vector& position) {
+		mPosition = position;
+		updateRegion();
+	}
+};
+
+static Broadphase* createBroadphase(const String& name) {
+	if(name == "quadtree")
+		return new QuadTree(Vector(0, 0), Vector(WIDTH, WIDTH));
+	if(name == "loosequadtree")
+		return new QuadTree(Vector(0, 0), Vector(WIDTH, WIDTH), 5, 2, 3);
+	if(name == "linearquadtree")
+		return new LinearQuadTree(Vector(WIDTH, WIDTH));
+	if(name == "spatialhash")
+		return new SpatialHash(Vector(WIDTH, WIDTH), 60);
+	if(name == "sweepandprune")
+		return new SweepAndPrune();
+	return new AABBTree();
+}
+
+static void generate(vector<unique_ptr<BenchNode> >& nodes) {
+	std::mt19937 random(42);
+	std::uniform_real_distribution<double> position(0, WIDTH);
+	//Most players are small, a few have eaten a lot
+	std::uniform_real_distribution<double> logMass(log(10.), log(30000.));
+	for(size_t i = 0; i < FOOD; i++)
+		nodes.emplace_back(new BenchNode(Vector(position(random), position(random)), 5, false));
+	for(size_t i = 0; i < BALLS; i++) {
+		double mass = exp(logMass(random));
+		double size = 15 + 150.0 * log((mass + 150.0) / 150.0);
+		nodes.emplace_back(new BenchNode(Vector(position(random), position(random)), size, true));
+	}
+}
+
+static bool load(const char* file, vector<unique_ptr<BenchNode> >& nodes) {
+	FILE* f = fopen(file, "r");
+	if(!f) {
+		fprintf(stderr, "Can not open %s\n", file);
+		return false;
+	}
+	double x, y, size;
+	int moving;
+	while(fscanf(f, "%lf %lf %lf %d", &x, &y, &size, &moving) == 4)
+		nodes.emplace_back(new BenchNode(Vector(x, y), size, moving != 0));
+	fclose(f);
+	return true;
+}
+
+//Next to this file, the benches are run from the build directory
+static String getRecordedFile() {
+	String file = __FILE__;
+	size_t slash = file.rfind('/');
+	return (slash == String::npos ? String() : file.substr(0, slash + 1)) + "RecordedLobby.txt";
+}
+
+static bool run(vector<unique_ptr<BenchNode> >& nodes) {
+	vector<Vector> start;
+	for(auto& node : nodes)
+		start.push_back(node->getPosition());
+
+	const char* names[] = {"quadtree", "loosequadtree", "linearquadtree", "spatialhash", "sweepandprune", "aabbtree"};
+	uint64_t expected = 0;
+	bool ok = true;
+	for(const char* name : names) {
+		unique_ptr<Broadphase> broadphase(createBroadphase(name));
+		std::mt19937 random(7);
+		std::uniform_real_distribution<double> turn(-0.3, 0.3);
+		for(size_t i = 0; i < nodes.size(); i++)
+			nodes[i]->reset(start[i]);
+		for(auto& node : nodes)
+			broadphase->add(node.get());
+
+		//Pairs may be reported twice by some broadphases, so only distinct ones are counted
+		vector<std::pair<QuadTreeNodePtr, QuadTreeNodePtr> > pairs;
+		auto collect = [&pairs] (QuadTreeNodePtr e1, QuadTreeNodePtr e2) { pairs.push_back(std::make_pair(min(e1, e2), max(e1, e2))); };
+		broadphase->doCollisionCheck(collect);
+		broadphase->collectPairTests();
+
+		using namespace std::chrono;
+		high_resolution_clock::duration time(0);
+		uint64_t found = 0;
+		for(size_t t = 0; t < TICKS; t++) {
+			auto begin = high_resolution_clock::now();
+			for(auto& node : nodes) {
+				if(!node->mMoving) continue;
+				double angle = turn(random);
+				Vector& d = node->mDirection;
+				d = Vector(d.x * cos(angle) - d.y * sin(angle), d.x * sin(angle) + d.y * cos(angle));
+				Vector pos = node->getPosition() + d * (node->mSpeed / TICK_RATE);
+				//Turn around at the border
+				if(pos.x < 0 || pos.x > WIDTH || pos.y < 0 || pos.y > WIDTH) {
+					d = d * -1;
+					continue;
+				}
+				node->move(pos);
+			}
+			pairs.clear();
+			broadphase->doCollisionCheck(collect);
+			time += high_resolution_clock::now() - begin;
+
+			std::sort(pairs.begin(), pairs.end());
+			found += std::unique(pairs.begin(), pairs.end()) - pairs.begin();
+		}
+		double ms = duration_cast<duration<double, std::milli> >(time).count() / TICKS;
+		printf("%-14s %8.3lf ms per tick, %8lu pair tests per tick, %lu pairs\n", name, ms, broadphase->collectPairTests() / TICKS, found);
+		if(expected == 0)
+			expected = found;
+		else if(found != expected) {
+			fprintf(stderr, "%s: found %lu pairs, expected %lu\n", name, found, expected);
+			ok = false;
+		}
+		for(auto& node : nodes)
+			broadphase->remove(node.get());
+	}
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	vector<unique_ptr<BenchNode> > nodes;
+	if(argc > 1)
+		return load(argv[1], nodes) && run(nodes) ? 0 : 1;
+
+	printf("Generated, %lu Balls over %lu Food\n", BALLS, FOOD);
+	generate(nodes);
+	bool ok = run(nodes);
+	nodes.clear();
+	String recorded = getRecordedFile();
+	printf("%s\n", recorded.c_str());
+	if(!load(recorded.c_str(), nodes))
+		return 1;
+	return run(nodes) && ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "QuadTree.h"
+#include "PackedIntersect.h"
+
+#include <chrono>
+#include <random>
+
+/*
+ * Compares QuadTreeNode::intersect on heap allocated elements with the packed
+ * kernels that QuadTree uses on its leafs.
+ */
+
+static const size_t ELEMENTS = 4096;
+static const size_t REPEAT = 200;
+
+class BenchNode : public QuadTreeNode {
+public:
+	BenchNode(const Vector& mPosition, double mSize) : QuadTreeNode(mPosition, mSize) { }
+	//Elements are much bigger than the node, so they are spread in memory like in the game
+	char mPadding[256];
+};
+
+template<typename Func>
+static double measure(const char* name, uint64_t& hits, Func func) {
+	using namespace std::chrono;
+	auto start = high_resolution_clock::now();
+	hits = 0;
+	for(size_t r = 0; r < REPEAT; r++)
+		hits += func();
+	double ns = duration_cast<duration<double, std::nano> >(high_resolution_clock::now() - start).count();
+	ns /= REPEAT * ELEMENTS * (PACKED_BATCH - 1);
+	printf("%-10s %6.3lf ns per test, %lu hits\n", name, ns, hits);
+	return ns;
+}
+
+int main() {
+	std::mt19937 random(42);
+	std::uniform_real_distribution<double> position(0, 500);
+	std::uniform_real_distribution<double> size(5, 60);
+
+	vector<unique_ptr<BenchNode> > nodes;
+	vector<QuadTreeNodePtr> elements;
+	vector<double> xs, ys, sizes;
+	for(size_t i = 0; i < ELEMENTS + PACKED_BATCH; i++) {
+		nodes.emplace_back(new BenchNode(Vector(position(random), position(random)), size(random)));
+		elements.push_back(nodes.back().get());
+		xs.push_back(elements.back()->getPosition().x);
+		ys.push_back(elements.back()->getPosition().y);
+		sizes.push_back(elements.back()->getSize());
+	}
+	//Shuffle the pointers, the elements of a leaf are not next to each other either
+	std::shuffle(elements.begin(), elements.end(), random);
+	for(size_t i = 0; i < elements.size(); i++) {
+		xs[i] = elements[i]->getPosition().x;
+		ys[i] = elements[i]->getPosition().y;
+		sizes[i] = elements[i]->getSize();
+	}
+
+	//Every element against the next PACKED_BATCH - 1 ones, like a full leaf
+	uint64_t hitsNode, hitsScalar, hitsPacked;
+	double node = measure("intersect", hitsNode, [&] {
+		uint64_t hits = 0;
+		for(size_t i = 0; i < ELEMENTS; i++)
+			for(size_t j = i + 1; j < i + PACKED_BATCH; j++)
+				hits += elements[i]->intersect(elements[j]);
+		return hits;
+	});
+	double scalar = measure("scalar", hitsScalar, [&] {
+		uint64_t hits = 0;
+		for(size_t i = 0; i < ELEMENTS; i++)
+			hits += __builtin_popcountll(intersectPackedScalar(xs[i], ys[i], sizes[i], &xs[i + 1], &ys[i + 1], &sizes[i + 1], PACKED_BATCH - 1));
+		return hits;
+	});
+	double packed = measure(getPackedInstructionSet(), hitsPacked, [&] {
+		uint64_t hits = 0;
+		for(size_t i = 0; i < ELEMENTS; i++)
+			hits += __builtin_popcountll(intersectPacked(xs[i], ys[i], sizes[i], &xs[i + 1], &ys[i + 1], &sizes[i + 1], PACKED_BATCH - 1));
+		return hits;
+	});
+
+	if(hitsNode != hitsScalar || hitsNode != hitsPacked) {
+		fprintf(stderr, "Results differ: %lu %lu %lu\n", hitsNode, hitsScalar, hitsPacked);
+		return 1;
+	}
+	printf("Speedup scalar: %.2lf %s: %.2lf\n", node / scalar, getPackedInstructionSet(), node / packed);
+	return 0;
+}
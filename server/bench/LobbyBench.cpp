@@ -0,0 +1,119 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "Gamefield.h"
+#include "Network/Server.h"
+#include "Network/Client.h"
+#include "Network/AgarPackets.h"
+
+#include <random>
+#include <set>
+
+/*
+ * Runs a lobby in real time with simulated players and prints its own stats at the end, like
+ * GetStats does for a connected client. The players join, steer, split and shoot through the same
+ * packets a client sends and start again after they died. The packets sent to them are serialized
+ * but dropped, the network itself is not part of the bench.
+ * Arguments: [broadphase] [players] [seconds] [staticIndex]
+ * Without staticIndex the lobby runs twice, with Food and Items in the static index and without it.
+ */
+
+static const double INPUT_RATE = 30;
+
+static mutex deadMutex;
+static std::set<uint64_t> deadClients;
+
+//Replaces the websocket server of Server.cpp
+class Server::ServerImpl { };
+
+Server::Server() { }
+Server::~Server() { }
+void Server::start(const String& ip, uint16_t port) { }
+void Server::run() { }
+void Server::stop() { }
+
+void Server::emit(uint64_t id, PacketPtr packet) {
+	packet->getData();
+	if(packet->getId() == PID_RIP) {
+		lock_guard<mutex> _lock(deadMutex);
+		deadClients.insert(id);
+	}
+}
+
+void Server::emit(PacketPtr packet) {
+	packet->getData();
+}
+
+static void start(ClientPtr client) {
+	auto packet = std::make_shared<StartPacket>();
+	packet->Name = "bench" + std::to_string(client->getId());
+	client->handlePacket(packet);
+}
+
+static void run(const Options& options, size_t players, double seconds) {
+	printf("%s, static index %s, %lu players, %.0lf s\n", options.collision.broadphase.c_str(), options.collision.staticIndex ? "on" : "off", players, seconds);
+	//The lobby spawns with rand()
+	srand(42);
+	std::mt19937 random(42);
+	std::uniform_real_distribution<double> target(-500, 500);
+	std::uniform_int_distribution<int> percent(0, 99);
+
+	ServerPtr server = std::make_shared<Server>();
+	GamefieldPtr lobby = std::make_shared<Gamefield>(server, "bench", options);
+	vector<ClientPtr> clients;
+	for(size_t i = 0; i < players; i++) {
+		clients.push_back(std::make_shared<Client>(i + 1, server.get()));
+		lobby->onJoin(clients.back(), PacketPtr());
+		start(clients.back());
+	}
+
+	//Input of all players at the rate of a client, the lobby updates on its own thread
+	auto interval = std::chrono::microseconds((uint64_t) (1e6 / INPUT_RATE));
+	auto end = std::chrono::steady_clock::now() + std::chrono::microseconds((uint64_t) (seconds * 1e6));
+	while(std::chrono::steady_clock::now() < end) {
+		auto next = std::chrono::steady_clock::now() + interval;
+		std::set<uint64_t> dead;
+		{
+			lock_guard<mutex> _lock(deadMutex);
+			dead.swap(deadClients);
+		}
+		for(ClientPtr& client : clients) {
+			if(dead.count(client->getId())) {
+				start(client);
+				continue;
+			}
+			//Relative to the center of the player
+			auto packet = std::make_shared<StructPacket<PID_UpdateTarget, TargetPacket> >(target(random), target(random));
+			client->handlePacket(packet);
+			int action = percent(random);
+			if(action < 3)
+				client->handlePacket(std::make_shared<EmptyPacket<PID_SplitUp> >());
+			else if(action < 8)
+				client->handlePacket(std::make_shared<EmptyPacket<PID_Shoot> >());
+		}
+		std::this_thread::sleep_until(next);
+	}
+
+	clients.front()->handlePacket(std::make_shared<StatsPacket>());
+	for(ClientPtr& client : clients)
+		client->handleDisconnect();
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.collision.broadphase = argc > 1 ? argv[1] : "quadtree";
+	size_t players = argc > 2 ? strtoul(argv[2], NULL, 10) : 50;
+	double seconds = argc > 3 ? atof(argv[3]) : 10;
+
+	if(argc > 4) {
+		options.collision.staticIndex = atoi(argv[4]) != 0;
+		run(options, players, seconds);
+		return 0;
+	}
+	for(bool staticIndex : {false, true}) {
+		options.collision.staticIndex = staticIndex;
+		run(options, players, seconds);
+	}
+	return 0;
+}
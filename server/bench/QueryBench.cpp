@@ -0,0 +1,143 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "QuadTree.h"
+#include "StaticIndex.h"
+
+#include <chrono>
+#include <random>
+
+/*
+ * Compares the queries of the QuadTree and the StaticIndex with a linear scan over all elements,
+ * like Gamefield::mElements would need without them.
+ */
+
+static const size_t ELEMENTS = 20000;
+static const size_t QUERIES = 2000;
+static const double WIDTH = 5000;
+static const size_t NEAREST = 8;
+
+class BenchNode : public QuadTreeNode {
+public:
+	BenchNode(const Vector& mPosition, double mSize, uint8_t type) : QuadTreeNode(mPosition, mSize) { setCollisionType(type, ~0u); }
+	char mPadding[256];
+};
+
+template<typename Func>
+static double measure(const char* name, uint64_t& found, Func func) {
+	using namespace std::chrono;
+	auto start = high_resolution_clock::now();
+	found = 0;
+	for(size_t q = 0; q < QUERIES; q++)
+		found += func(q);
+	double us = duration_cast<duration<double, std::micro> >(high_resolution_clock::now() - start).count() / QUERIES;
+	printf("%-14s %8.2lf us per query, %lu found\n", name, us, found);
+	return us;
+}
+
+static bool compare(const char* name, double tree, uint64_t foundTree, double scan, uint64_t foundScan) {
+	if(foundTree != foundScan) {
+		fprintf(stderr, "%s: results differ: %lu %lu\n", name, foundTree, foundScan);
+		return false;
+	}
+	printf("%-14s speedup %.1lf\n", name, scan / tree);
+	return true;
+}
+
+static bool run(Broadphase& tree, const vector<QuadTreeNodePtr>& elements, const vector<Vector>& centers) {
+	printf("%s\n", tree.getName());
+	//Visible area of a client and the pull radius of an item
+	const Vector view(800, 450);
+	const double radius = 300;
+	const uint32_t types = 1u << 0;
+
+	bool ok = true;
+	uint64_t foundTree, foundScan;
+	double treeTime, scanTime;
+
+	treeTime = measure("queryRect", foundTree, [&] (size_t q) {
+		uint64_t found = 0;
+		tree.queryRect(centers[q] - view, centers[q] + view, ~0u, [&found] (QuadTreeNodePtr) { found++; });
+		return found;
+	});
+	scanTime = measure("scanRect", foundScan, [&] (size_t q) {
+		uint64_t found = 0;
+		Vector from = centers[q] - view, to = centers[q] + view;
+		for(QuadTreeNodePtr e : elements)
+			if(e->getPosition().x >= from.x && e->getPosition().x <= to.x && e->getPosition().y >= from.y && e->getPosition().y <= to.y)
+				found++;
+		return found;
+	});
+	ok &= compare("rect", treeTime, foundTree, scanTime, foundScan);
+
+	treeTime = measure("queryCircle", foundTree, [&] (size_t q) {
+		uint64_t found = 0;
+		tree.queryCircle(centers[q], radius, types, [&found] (QuadTreeNodePtr) { found++; });
+		return found;
+	});
+	scanTime = measure("scanCircle", foundScan, [&] (size_t q) {
+		uint64_t found = 0;
+		for(QuadTreeNodePtr e : elements)
+			if((types & (1u << e->getCollisionType())) && e->getPosition().distanceSquared(centers[q]) <= radius * radius)
+				found++;
+		return found;
+	});
+	ok &= compare("circle", treeTime, foundTree, scanTime, foundScan);
+
+	//Sum of the distances, so a different result is noticed
+	Broadphase::Nearest result[NEAREST];
+	treeTime = measure("nearestK", foundTree, [&] (size_t q) {
+		size_t count = tree.nearestK(centers[q], NEAREST, ~0u, result);
+		uint64_t sum = 0;
+		for(size_t i = 0; i < count; i++)
+			sum += (uint64_t) result[i].distance;
+		return sum;
+	});
+	scanTime = measure("scanNearest", foundScan, [&] (size_t q) {
+		size_t count = 0;
+		for(QuadTreeNodePtr e : elements) {
+			double distance = e->getPosition().distanceSquared(centers[q]);
+			if(count == NEAREST && distance >= result[NEAREST - 1].distance)
+				continue;
+			size_t i = count < NEAREST ? count++ : NEAREST - 1;
+			for(; i > 0 && result[i - 1].distance > distance; i--)
+				result[i] = result[i - 1];
+			result[i] = Broadphase::Nearest {e, distance};
+		}
+		uint64_t sum = 0;
+		for(size_t i = 0; i < count; i++)
+			sum += (uint64_t) result[i].distance;
+		return sum;
+	});
+	ok &= compare("nearest", treeTime, foundTree, scanTime, foundScan);
+	return ok;
+}
+
+int main() {
+	std::mt19937 random(42);
+	std::uniform_real_distribution<double> position(0, WIDTH);
+	std::uniform_real_distribution<double> size(5, 60);
+
+	QuadTree tree(Vector(0, 0), Vector(WIDTH, WIDTH));
+	StaticIndex index(Vector(WIDTH, WIDTH), 60);
+	vector<unique_ptr<BenchNode> > nodes;
+	vector<QuadTreeNodePtr> elements;
+	for(size_t i = 0; i < ELEMENTS; i++) {
+		//Mostly Food (type 1) like in the game
+		nodes.emplace_back(new BenchNode(Vector(position(random), position(random)), size(random), i % 10 ? 1 : 0));
+		elements.push_back(nodes.back().get());
+		tree.add(elements.back());
+		index.add(elements.back());
+	}
+	//The tree is split with the collision check
+	static_cast<Broadphase&>(tree).doCollisionCheck([] (QuadTreeNodePtr, QuadTreeNodePtr) {});
+
+	vector<Vector> centers;
+	for(size_t q = 0; q < QUERIES; q++)
+		centers.emplace_back(position(random), position(random));
+
+	bool ok = run(tree, elements, centers);
+	ok = run(index, elements, centers) && ok;
+	return ok ? 0 : 1;
+}
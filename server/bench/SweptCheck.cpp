@@ -0,0 +1,84 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "QuadTree.h"
+#include "SweepIndex.h"
+
+#include <random>
+#include <set>
+
+/*
+ * Compares the pairs of the SweepIndex with a brute force swept test over all pairs of
+ * elements. Pairs that already intersect at the end of the tick are left to the other
+ * broadphases, so they are not expected here either.
+ */
+
+static const size_t ELEMENTS = 6000;
+static const double WIDTH = 3000;
+static const double CELL_SIZE = 60;
+
+class CheckNode : public QuadTreeNode {
+public:
+	CheckNode(const Vector& mPosition, double mSize) : QuadTreeNode(mPosition, mSize) { }
+};
+
+typedef std::pair<QuadTreeNodePtr, QuadTreeNodePtr> Pair;
+
+static Pair makePair(QuadTreeNodePtr a, QuadTreeNodePtr b) {
+	return a < b ? Pair(a, b) : Pair(b, a);
+}
+
+int main() {
+	std::mt19937 random(42);
+	std::uniform_real_distribution<double> position(0, WIDTH);
+	std::uniform_real_distribution<double> smallSize(5, 25), bigSize(30, 230);
+	std::uniform_real_distribution<double> angle(0, 2 * M_PI), distance(1, 80);
+	std::uniform_int_distribution<int> percent(0, 99);
+
+	//Mostly Food sized elements, some Balls and 5% of them moved further than their size
+	vector<unique_ptr<CheckNode> > nodes;
+	vector<QuadTreeNodePtr> elements, swept;
+	for(size_t i = 0; i < ELEMENTS; i++) {
+		double size = percent(random) < 90 ? smallSize(random) : bigSize(random);
+		nodes.emplace_back(new CheckNode(Vector(position(random), position(random)), size));
+		if(percent(random) < 5) {
+			double a = angle(random), length = size + distance(random);
+			nodes.back()->setSweep(Vector(cos(a) * length, sin(a) * length));
+			swept.push_back(nodes.back().get());
+		}
+		elements.push_back(nodes.back().get());
+	}
+
+	SweepIndex index(Vector(WIDTH, WIDTH), CELL_SIZE);
+	std::set<Pair> found;
+	size_t calls = 0;
+	index.doCollisionCheck(swept, elements, [&] (QuadTreeNodePtr a, QuadTreeNodePtr b) {
+		calls++;
+		found.insert(makePair(a, b));
+	});
+
+	size_t expected = 0, missing = 0, extra = 0;
+	for(size_t i = 0; i < elements.size(); i++) {
+		for(size_t j = i + 1; j < elements.size(); j++) {
+			QuadTreeNodePtr a = elements[i], b = elements[j];
+			if(!a->isSwept() && !b->isSwept())
+				continue;
+			if(a->intersect(b) || !a->sweptIntersect(b))
+				continue;
+			expected++;
+			if(!found.count(makePair(a, b)))
+				missing++;
+		}
+	}
+	for(const Pair& pair : found)
+		if(pair.first->intersect(pair.second) || !pair.first->sweptIntersect(pair.second))
+			extra++;
+
+	printf("%lu swept elements, %lu pairs expected, %lu found, %lu pair tests\n", swept.size(), expected, found.size(), index.collectPairTests());
+	if(missing || extra || calls != found.size()) {
+		fprintf(stderr, "%lu pairs missing, %lu wrong, %lu reported twice\n", missing, extra, calls - found.size());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,107 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "QuadTree.h"
+
+#include <random>
+
+/*
+ * Random adds, moves, resizes and removals on the QuadTree, some of them from inside a query
+ * like the game does. After every step the tree is validated, which also compares every cached
+ * neighbour list with a fresh lookup. Runs the classic and the loose tree, each updated and rebuilt.
+ * Arguments: [steps] [seed]
+ */
+
+static const double WIDTH = 2000;
+
+class FuzzNode : public QuadTreeNode {
+public:
+	FuzzNode(const Vector& mPosition, double mSize) : QuadTreeNode(mPosition, mSize) { }
+
+	void move(const Vector& movement) {
+		mPosition = mPosition + movement;
+		mPosition.x = min(max(mPosition.x, 0.), WIDTH);
+		mPosition.y = min(max(mPosition.y, 0.), WIDTH);
+		updateRegion();
+	}
+	void resize(double size) {
+		mSize = size;
+		updateRegion();
+	}
+};
+
+static bool fuzz(double looseness, bool rebuild, size_t steps, uint32_t seed) {
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<double> position(0, WIDTH);
+	std::uniform_int_distribution<int> movement(-40, 40), size(15, 315), percent(0, 99);
+
+	QuadTree tree(Vector(0, 0), Vector(WIDTH, WIDTH), 5, 2, looseness);
+	tree.setRebuild(rebuild);
+	//Removed elements stay allocated, a removal inside a query is only applied after it
+	vector<unique_ptr<FuzzNode> > nodes;
+	vector<FuzzNode*> live;
+	auto pick = [&] { return std::uniform_int_distribution<size_t>(0, live.size() - 1)(random); };
+
+	for(size_t step = 0; step < steps; step++) {
+		int op = percent(random);
+		if(op < 24 || live.size() < 5) {
+			nodes.emplace_back(new FuzzNode(Vector(position(random), position(random)), percent(random) < 66 ? 5 : size(random)));
+			live.push_back(nodes.back().get());
+			tree.add(live.back());
+		} else if(op < 40) {
+			size_t i = pick();
+			if(!tree.remove(live[i])) {
+				printf("Step %lu: remove failed\n", step);
+				return false;
+			}
+			live[i] = live.back();
+			live.pop_back();
+		} else {
+			FuzzNode* node = live[pick()];
+			if(percent(random) < 20)
+				node->resize(size(random));
+			node->move(Vector(movement(random), movement(random)));
+		}
+
+		if(step % 13 == 0) {
+			bool removed = false;
+			tree.queryCircle(Vector(position(random), position(random)), 300, ~0u, [&] (QuadTreeNodePtr elem) {
+				FuzzNode* node = (FuzzNode*) elem;
+				if(percent(random) < 25)
+					node->move(Vector(movement(random), movement(random)));
+				if(!removed && percent(random) < 33) {
+					removed = true;
+					tree.remove(node);
+					live.erase(std::find(live.begin(), live.end(), node));
+				}
+			});
+		}
+		bool checked = step % 7 == 0;
+		if(checked)
+			((Broadphase&) tree).doCollisionCheck([] (QuadTreeNodePtr, QuadTreeNodePtr) { });
+
+		if(!tree.validate()) {
+			printf("Step %lu op %d\n", step, op);
+			return false;
+		}
+		//Added elements are only inserted by the check
+		if(checked && tree.getElementCount() != live.size()) {
+			printf("Step %lu: %lu elements in the tree, %lu added\n", step, tree.getElementCount(), live.size());
+			return false;
+		}
+	}
+	printf("%-24s %6lu elements %6lu nodes\n", tree.getName(), live.size(), tree.getChildCount());
+	return true;
+}
+
+int main(int argc, char** argv) {
+	size_t steps = argc > 1 ? strtoul(argv[1], NULL, 10) : 50000;
+	uint32_t seed = argc > 2 ? (uint32_t) strtoul(argv[2], NULL, 10) : 42;
+
+	bool ok = true;
+	for(double looseness : {1., 2.})
+		for(bool rebuild : {false, true})
+			ok = fuzz(looseness, rebuild, steps, seed) && ok;
+	return ok ? 0 : 1;
+}
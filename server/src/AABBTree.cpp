@@ -0,0 +1,385 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "AABBTree.h"
+#include "QuadTree.h"
+
+static inline bool overlaps(const Vector& min1, const Vector& max1, const Vector& min2, const Vector& max2) {
+	return min1.x <= max2.x && max1.x >= min2.x && min1.y <= max2.y && max1.y >= min2.y;
+}
+
+static inline bool contains(const Vector& outerMin, const Vector& outerMax, const Vector& min, const Vector& max) {
+	return outerMin.x <= min.x && outerMin.y <= min.y && max.x <= outerMax.x && max.y <= outerMax.y;
+}
+
+static inline double perimeter(const Vector& min, const Vector& max) {
+	//Half of it, only used for comparisons
+	return (max.x - min.x) + (max.y - min.y);
+}
+
+static inline double unitedPerimeter(const Vector& min1, const Vector& max1, const Vector& min2, const Vector& max2) {
+	return (std::max(max1.x, max2.x) - std::min(min1.x, min2.x)) + (std::max(max1.y, max2.y) - std::min(min1.y, min2.y));
+}
+
+AABBTree::AABBTree() {
+}
+
+void AABBTree::findCollisions() {
+	{
+		lock_guard<mutex> _lock(mMutex);
+		insertNew();
+		mRelocations += refit();
+	}
+
+	runTasks((mNodes.size() + TASK_SIZE - 1) / TASK_SIZE, [this] (size_t task, TaskResult& result) {
+		vector<uint32_t> stack;
+		size_t end = min(mNodes.size(), (task + 1) * TASK_SIZE);
+		for(size_t i = task * TASK_SIZE; i < end; i++) {
+			if(mNodes[i].height == 0)
+				query((uint32_t) i, stack, result);
+		}
+	});
+}
+
+void AABBTree::query(uint32_t leaf, vector<uint32_t>& stack, TaskResult& result) {
+	QuadTreeNodePtr elem = mNodes[leaf].elem;
+	if(elem->isDeleted())
+		return;
+	//The center of one element is inside the other one, so their exact boxes overlap
+	Vector size(elem->getSize(), elem->getSize());
+	Vector min = elem->getPosition() - size, max = elem->getPosition() + size;
+	//A pair is reported by the element with the lower collision type, e.g. Food (static and lots of it)
+	//never has to query. Subtrees without a type in the mask are skipped
+	uint8_t type = elem->getCollisionType();
+	uint32_t mask = elem->getCollisionMask() & ~((1u << type) - 1);
+	if(!mask)
+		return;
+
+	stack.clear();
+	stack.push_back(mRoot);
+	while(!stack.empty()) {
+		const Node& node = mNodes[stack.back()];
+		uint32_t index = stack.back();
+		stack.pop_back();
+		if(!(node.types & mask) || !overlaps(min, max, node.min, node.max))
+			continue;
+		if(!node.isLeaf()) {
+			stack.push_back(node.childs[0]);
+			stack.push_back(node.childs[1]);
+			continue;
+		}
+		//Both leafs of the same type find each other, only the one with the smaller index reports the pair
+		QuadTreeNodePtr other = node.elem;
+		if(other->getCollisionType() == type && index <= leaf) continue;
+		if(other->isDeleted()) continue;
+		result.pairTests++;
+		if(elem->intersect(other))
+			result.pairs.push_back(CollisionPair {elem, other});
+	}
+}
+
+bool AABBTree::add(QuadTreeNodePtr elem) {
+	lock_guard<mutex> _lock(mMutex);
+	elem->mBroadphase = this;
+	elem->mProxy = NO_NODE;
+	mNewElements.push_back(elem);
+	return true;
+}
+
+void AABBTree::insertNew() {
+	for(QuadTreeNodePtr elem : mNewElements) {
+		uint32_t leaf = allocateNode();
+		Node& node = mNodes[leaf];
+		node.elem = elem;
+		node.height = 0;
+		node.types = 1u << elem->getCollisionType();
+		node.position = elem->getPosition();
+		fatten(node, Vector::ZERO);
+		insertLeaf(leaf);
+		elem->mProxy = leaf;
+		mElementCount++;
+	}
+	mNewElements.clear();
+}
+
+bool AABBTree::remove(QuadTreeNodePtr elem) {
+	lock_guard<mutex> _lock(mMutex);
+	if(elem->mBroadphase != this)
+		return false;
+	uint32_t leaf = elem->mProxy;
+	if(leaf == NO_NODE) { //Still queued
+		auto it = std::find(mNewElements.begin(), mNewElements.end(), elem);
+		if(it == mNewElements.end())
+			return false;
+		*it = mNewElements.back();
+		mNewElements.pop_back();
+		elem->mBroadphase = NULL;
+		return true;
+	}
+	if(leaf >= mNodes.size() || mNodes[leaf].height != 0 || mNodes[leaf].elem != elem)
+		return false;
+	removeLeaf(leaf);
+	freeNode(leaf);
+	elem->mBroadphase = NULL;
+	mElementCount--;
+	return true;
+}
+
+size_t AABBTree::refit() {
+	size_t moved = 0;
+	//Leafs keep their index when they are reinserted, only inner nodes are reused
+	for(uint32_t i = 0; i < mNodes.size(); i++) {
+		if(mNodes[i].height != 0)
+			continue;
+		QuadTreeNodePtr elem = mNodes[i].elem;
+		Vector movement = elem->getPosition() - mNodes[i].position;
+		mNodes[i].position = elem->getPosition();
+		//Also the size, e.g. a Ball that ate something
+		Vector size(elem->getSize(), elem->getSize());
+		if(contains(mNodes[i].min, mNodes[i].max, elem->getPosition() - size, elem->getPosition() + size))
+			continue;
+		removeLeaf(i);
+		fatten(mNodes[i], movement);
+		insertLeaf(i);
+		moved++;
+	}
+	return moved;
+}
+
+void AABBTree::fatten(Node& leaf, const Vector& movement) {
+	double size = leaf.elem->getSize() * (1 + FAT_FACTOR);
+	leaf.min = leaf.elem->getPosition() - Vector(size, size);
+	leaf.max = leaf.elem->getPosition() + Vector(size, size);
+	//Only in the direction it moves, like the displacement of Box2D
+	Vector ahead = movement * PREDICTED_TICKS;
+	if(ahead.x < 0)
+		leaf.min.x += ahead.x;
+	else
+		leaf.max.x += ahead.x;
+	if(ahead.y < 0)
+		leaf.min.y += ahead.y;
+	else
+		leaf.max.y += ahead.y;
+}
+
+uint32_t AABBTree::allocateNode() {
+	uint32_t index;
+	if(mFreeNode != NO_NODE) {
+		index = mFreeNode;
+		mFreeNode = mNodes[index].parent;
+	} else {
+		index = (uint32_t) mNodes.size();
+		mNodes.emplace_back();
+	}
+	Node& node = mNodes[index];
+	node.parent = NO_NODE;
+	node.childs[0] = node.childs[1] = NO_NODE;
+	node.height = 0;
+	node.types = 0;
+	node.elem = NULL;
+	mNodeCount++;
+	return index;
+}
+
+void AABBTree::freeNode(uint32_t index) {
+	Node& node = mNodes[index];
+	node.parent = mFreeNode;
+	node.height = -1;
+	node.elem = NULL;
+	mFreeNode = index;
+	mNodeCount--;
+}
+
+void AABBTree::insertLeaf(uint32_t leaf) {
+	if(mRoot == NO_NODE) {
+		mRoot = leaf;
+		mNodes[leaf].parent = NO_NODE;
+		return;
+	}
+
+	//Find the sibling that grows the tree the least
+	Vector min = mNodes[leaf].min, max = mNodes[leaf].max;
+	uint32_t index = mRoot;
+	while(!mNodes[index].isLeaf()) {
+		const Node& node = mNodes[index];
+		double area = perimeter(node.min, node.max);
+		double united = unitedPerimeter(node.min, node.max, min, max);
+		//Cost of a new parent for this node and the leaf
+		double cost = 2 * united;
+		//Minimum cost of pushing the leaf further down
+		double inheritance = 2 * (united - area);
+
+		double childCosts[2];
+		for(int c = 0; c < 2; c++) {
+			const Node& child = mNodes[node.childs[c]];
+			childCosts[c] = unitedPerimeter(child.min, child.max, min, max) + inheritance;
+			if(!child.isLeaf())
+				childCosts[c] -= perimeter(child.min, child.max);
+		}
+		if(cost < childCosts[0] && cost < childCosts[1])
+			break;
+		index = childCosts[0] < childCosts[1] ? node.childs[0] : node.childs[1];
+	}
+
+	uint32_t sibling = index;
+	uint32_t parent = allocateNode();
+	Node& newParent = mNodes[parent];
+	uint32_t oldParent = mNodes[sibling].parent;
+	newParent.parent = oldParent;
+	newParent.min = Vector(std::min(min.x, mNodes[sibling].min.x), std::min(min.y, mNodes[sibling].min.y));
+	newParent.max = Vector(std::max(max.x, mNodes[sibling].max.x), std::max(max.y, mNodes[sibling].max.y));
+	newParent.height = mNodes[sibling].height + 1;
+	newParent.types = mNodes[sibling].types | mNodes[leaf].types;
+	newParent.childs[0] = sibling;
+	newParent.childs[1] = leaf;
+	mNodes[sibling].parent = parent;
+	mNodes[leaf].parent = parent;
+	if(oldParent == NO_NODE)
+		mRoot = parent;
+	else if(mNodes[oldParent].childs[0] == sibling)
+		mNodes[oldParent].childs[0] = parent;
+	else
+		mNodes[oldParent].childs[1] = parent;
+
+	//Fix the boxes and heights above the leaf
+	for(index = mNodes[leaf].parent; index != NO_NODE; index = mNodes[index].parent) {
+		index = balance(index);
+		Node& node = mNodes[index];
+		const Node& child1 = mNodes[node.childs[0]];
+		const Node& child2 = mNodes[node.childs[1]];
+		node.height = 1 + std::max(child1.height, child2.height);
+		node.types = child1.types | child2.types;
+		node.min = Vector(std::min(child1.min.x, child2.min.x), std::min(child1.min.y, child2.min.y));
+		node.max = Vector(std::max(child1.max.x, child2.max.x), std::max(child1.max.y, child2.max.y));
+	}
+}
+
+void AABBTree::removeLeaf(uint32_t leaf) {
+	if(leaf == mRoot) {
+		mRoot = NO_NODE;
+		return;
+	}
+
+	uint32_t parent = mNodes[leaf].parent;
+	uint32_t grandParent = mNodes[parent].parent;
+	uint32_t sibling = mNodes[parent].childs[0] == leaf ? mNodes[parent].childs[1] : mNodes[parent].childs[0];
+	freeNode(parent);
+	mNodes[leaf].parent = NO_NODE;
+	mNodes[sibling].parent = grandParent;
+	if(grandParent == NO_NODE) {
+		mRoot = sibling;
+		return;
+	}
+	if(mNodes[grandParent].childs[0] == parent)
+		mNodes[grandParent].childs[0] = sibling;
+	else
+		mNodes[grandParent].childs[1] = sibling;
+
+	for(uint32_t index = grandParent; index != NO_NODE; index = mNodes[index].parent) {
+		index = balance(index);
+		Node& node = mNodes[index];
+		const Node& child1 = mNodes[node.childs[0]];
+		const Node& child2 = mNodes[node.childs[1]];
+		node.height = 1 + std::max(child1.height, child2.height);
+		node.types = child1.types | child2.types;
+		node.min = Vector(std::min(child1.min.x, child2.min.x), std::min(child1.min.y, child2.min.y));
+		node.max = Vector(std::max(child1.max.x, child2.max.x), std::max(child1.max.y, child2.max.y));
+	}
+}
+
+uint32_t AABBTree::balance(uint32_t a) {
+	Node& nodeA = mNodes[a];
+	if(nodeA.isLeaf() || nodeA.height < 2)
+		return a;
+
+	//Rotates the higher child up, its higher child stays below it and the other one moves to a
+	for(int side = 0; side < 2; side++) {
+		uint32_t low = nodeA.childs[side], high = nodeA.childs[1 - side];
+		if(mNodes[high].height - mNodes[low].height <= 1)
+			continue;
+
+		Node& nodeHigh = mNodes[high];
+		uint32_t child1 = nodeHigh.childs[0], child2 = nodeHigh.childs[1];
+		nodeHigh.childs[0] = a;
+		nodeHigh.parent = nodeA.parent;
+		nodeA.parent = high;
+		if(nodeHigh.parent == NO_NODE)
+			mRoot = high;
+		else if(mNodes[nodeHigh.parent].childs[0] == a)
+			mNodes[nodeHigh.parent].childs[0] = high;
+		else
+			mNodes[nodeHigh.parent].childs[1] = high;
+
+		uint32_t keep = child1, move = child2;
+		if(mNodes[child2].height > mNodes[child1].height)
+			std::swap(keep, move);
+		nodeHigh.childs[1] = keep;
+		nodeA.childs[1 - side] = move;
+		mNodes[move].parent = a;
+
+		const Node& nodeLow = mNodes[low];
+		const Node& nodeMove = mNodes[move];
+		const Node& nodeKeep = mNodes[keep];
+		nodeA.min = Vector(std::min(nodeLow.min.x, nodeMove.min.x), std::min(nodeLow.min.y, nodeMove.min.y));
+		nodeA.max = Vector(std::max(nodeLow.max.x, nodeMove.max.x), std::max(nodeLow.max.y, nodeMove.max.y));
+		nodeA.height = 1 + std::max(nodeLow.height, nodeMove.height);
+		nodeA.types = nodeLow.types | nodeMove.types;
+		nodeHigh.min = Vector(std::min(nodeA.min.x, nodeKeep.min.x), std::min(nodeA.min.y, nodeKeep.min.y));
+		nodeHigh.max = Vector(std::max(nodeA.max.x, nodeKeep.max.x), std::max(nodeA.max.y, nodeKeep.max.y));
+		nodeHigh.height = 1 + std::max(nodeA.height, nodeKeep.height);
+		nodeHigh.types = nodeA.types | nodeKeep.types;
+		return high;
+	}
+	return a;
+}
+
+void AABBTree::queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor) {
+	//The nodes are only changed by the simulation thread, added elements are queued
+	if(mRoot == NO_NODE)
+		return;
+	size_t begin = mFound.size();
+	mQueryStack.clear();
+	mQueryStack.push_back(mRoot);
+	while(!mQueryStack.empty()) {
+		const Node& node = mNodes[mQueryStack.back()];
+		mQueryStack.pop_back();
+		if(!(node.types & types) || !overlaps(from, to, node.min, node.max))
+			continue;
+		if(!node.isLeaf()) {
+			mQueryStack.push_back(node.childs[0]);
+			mQueryStack.push_back(node.childs[1]);
+		} else if(matches(node.elem, from, to, types))
+			mFound.push_back(node.elem);
+	}
+	//After the walk, the visitor may remove elements
+	visitFound(begin, visitor);
+}
+
+size_t AABBTree::nearestK(const Vector& position, size_t k, uint32_t types, Nearest* result) {
+	size_t count = 0;
+	if(k > 0 && mRoot != NO_NODE)
+		nearestK(mRoot, position, k, types, result, count);
+	return count;
+}
+
+void AABBTree::nearestK(uint32_t index, const Vector& position, size_t k, uint32_t types, Nearest* result, size_t& count) const {
+	const Node& node = mNodes[index];
+	if(!(node.types & types) || (count == k && getDistance(node, position) >= result[k - 1].distance))
+		return;
+	if(node.isLeaf()) {
+		if(!node.elem->isDeleted())
+			insertNearest(result, count, k, node.elem, node.elem->getPosition().distanceSquared(position));
+		return;
+	}
+	//Nearer child first, so the other one can be skipped more often
+	uint32_t first = getDistance(mNodes[node.childs[0]], position) <= getDistance(mNodes[node.childs[1]], position) ? 0 : 1;
+	nearestK(node.childs[first], position, k, types, result, count);
+	nearestK(node.childs[1 - first], position, k, types, result, count);
+}
+
+double AABBTree::getDistance(const Node& node, const Vector& position) {
+	double dx = max(max(node.min.x - position.x, position.x - node.max.x), 0.);
+	double dy = max(max(node.min.y - position.y, position.y - node.max.y), 0.);
+	return dx * dx + dy * dy;
+}
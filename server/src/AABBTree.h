@@ -0,0 +1,101 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_AABBTREE_H
+#define SERVER_AABBTREE_H
+
+#include "GlobalDefs.h"
+#include "Vector.h"
+#include "Broadphase.h"
+
+/*
+ * Dynamic bounding volume tree. Every element is a leaf with a box that is larger than the
+ * element and reaches further in the direction it moves (see fatten), so it is only moved in
+ * the tree after it left this box.
+ * Unlike the quadtrees the nodes adapt to the element sizes, a big Ball is just a big leaf
+ * and does not force all Food around it into the same node.
+ *
+ * Leaves are inserted next to the sibling that grows the tree the least (perimeter heuristic)
+ * and the tree is kept balanced by rotations like in Box2D.
+ * Added elements are queued and inserted at the start of the next check, the tasks of a check
+ * read the nodes without a lock.
+ */
+class AABBTree : public Broadphase {
+private:
+	struct Node {
+		Vector min;
+		Vector max;
+		//Next free node if the node is not used
+		uint32_t parent;
+		uint32_t childs[2];
+		//Leafs have height 0, unused nodes -1
+		int32_t height;
+		//Collision types of all leafs below
+		uint32_t types;
+		QuadTreeNodePtr elem;
+		//Position of the element at the last check, the difference is its movement in one tick
+		Vector position;
+
+		bool isLeaf() const { return childs[0] == NO_NODE; }
+	};
+	static const uint32_t NO_NODE = (uint32_t) -1;
+	//Leaf boxes are larger than the element by this part of its size
+	static constexpr double FAT_FACTOR = 0.25;
+	//and reach the position of a moving element this many ticks ahead
+	static constexpr double PREDICTED_TICKS = 4;
+	//Nodes tested by one task
+	static const size_t TASK_SIZE = 512;
+
+	vector<Node> mNodes;
+	uint32_t mRoot = NO_NODE;
+	uint32_t mFreeNode = NO_NODE;
+	size_t mNodeCount = 0;
+	size_t mElementCount = 0;
+	vector<QuadTreeNodePtr> mNewElements;
+	//Nodes still to visit by queryRect
+	vector<uint32_t> mQueryStack;
+
+	mutex mMutex;
+
+public:
+	AABBTree();
+
+	virtual bool add(QuadTreeNodePtr elem);
+	virtual bool remove(QuadTreeNodePtr elem);
+	virtual void update(QuadTreeNodePtr elem) {} //Leaf boxes are checked on every check
+
+	virtual size_t getElementCount() const { return mElementCount + mNewElements.size(); }
+	virtual size_t getChildCount() const { return mNodeCount; }
+
+	virtual const char* getName() const { return "aabbtree"; }
+
+	//Walk the tree, the leaf boxes contain the elements as of the last check
+	virtual void queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor);
+	virtual size_t nearestK(const Vector& position, size_t k, uint32_t types, Nearest* result);
+
+protected:
+	virtual void findCollisions();
+
+private:
+	uint32_t allocateNode();
+	void freeNode(uint32_t node);
+
+	void insertLeaf(uint32_t leaf);
+	void removeLeaf(uint32_t leaf);
+	//Rotates the higher child up if the subtree is unbalanced, returns the new subtree root
+	uint32_t balance(uint32_t node);
+	//Box of the element, extended by the movement in the last tick
+	void fatten(Node& leaf, const Vector& movement);
+	void insertNew();
+	//Reinserts the leafs whose element left its box, returns the number of moved leafs
+	size_t refit();
+
+	void query(uint32_t leaf, vector<uint32_t>& stack, TaskResult& result);
+	void nearestK(uint32_t index, const Vector& position, size_t k, uint32_t types, Nearest* result, size_t& count) const;
+	//Squared distance from the position to the box of the node, 0 if it is inside
+	static double getDistance(const Node& node, const Vector& position);
+};
+
+
+#endif //SERVER_AABBTREE_H
@@ -8,12 +8,12 @@
 #include "Player.h"
 #include "ItemEffect.h"
 
-Ball::Ball(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition, PlayerPtr player) :
-		Ball(mGamefield, mId, mPosition, player, mGamefield->getOptions().player.startMass) {
+Ball::Ball(GamefieldPtr mGamefield, ElementHandle mHandle, const Vector& mPosition, PlayerPtr player) :
+		Ball(mGamefield, mHandle, mPosition, player, mGamefield->getOptions().player.startMass) {
 }
 
-Ball::Ball(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition, PlayerPtr player, int32_t mass) :
-		MoveableElement(mGamefield, mId, mPosition, player->getColor(), 1, 1, 1),
+Ball::Ball(GamefieldPtr mGamefield, ElementHandle mHandle, const Vector& mPosition, PlayerPtr player, int32_t mass) :
+		MoveableElement(mGamefield, mHandle, ET_Ball, mPosition, player->getColor(), 1, 1, 1),
 		mPlayer(player) {
 	setMass(mGamefield->getOptions().player.startMass);
 }
@@ -36,7 +36,7 @@ BallPtr Ball::splitUp(const Vector& direction) {
 	b->setDirection(direction);
 	b->setBoost(direction * mGamefield->getOptions().shoot.speed, mGamefield->getOptions().shoot.acceleration);
 
-	mPlayer->addBall(b);
+	mPlayer->addBall(b->getHandle());
 
 	return b;
 }
@@ -66,19 +66,13 @@ void Ball::applyEffect(ItemEffectPtr effect) {
 
 void Ball::setMass(uint32_t mass) {
 	mSize = mGamefield->getOptions().player.defaultSize + 150.0 * log((mass + 150.0) / 150.0);
-	mMaxSpeed = mGamefield->getOptions().player.maxSpeed * exp(-mGamefield->getOptions().player.speedPenalty * mass);
+	setMaxSpeed(mGamefield->getOptions().player.maxSpeed * exp(-mGamefield->getOptions().player.speedPenalty * mass));
 	Element::setMass(mass);
 }
 
-bool Ball::tryEat(ElementPtr other) {
-	if (other->getMass() > 0 && other->getSize() * mGamefield->getOptions().player.eatFactor < mSize) {
-		if(other->getType() == ET_Ball) {
-			BallPtr ball(std::dynamic_pointer_cast<Ball>(other));
-			if(ball->hasEffect(IT_Invincible))
-				return false;
-		}
-
-		this->addMass(other->getMass());
+bool Ball::tryEat(Element& other) {
+	if (other.getMass() > 0 && other.getSize() * mGamefield->getOptions().player.eatFactor < mSize) {
+		this->addMass(other.getMass());
 		mGamefield->destroyElement(other);
 		mPlayer->updateClient();
 		return true;
@@ -86,6 +80,12 @@ bool Ball::tryEat(ElementPtr other) {
 	return false;
 }
 
+bool Ball::tryEat(Ball& other) {
+	if(other.hasEffect(IT_Invincible))
+		return false;
+	return tryEat(static_cast<Element&>(other));
+}
+
 void Ball::update(double timediff) {
 	MoveableElement::update(timediff);
 
@@ -112,6 +112,6 @@ void Ball::update(double timediff) {
 
 ElementData Ball::get() const {
 	ElementData ed = Element::get();
-	ed.name = mPlayer->getName();
+	ed.name = &mPlayer->getName();
 	return ed;
 }
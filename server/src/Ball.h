@@ -18,15 +18,17 @@ private:
 	unordered_map<uint8_t, ItemEffectPtr> mItemEffects;
 
 public:
-	Ball(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition, PlayerPtr player);
-	Ball(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition, PlayerPtr player, int32_t mass);
+	Ball(GamefieldPtr mGamefield, ElementHandle mHandle, const Vector& mPosition, PlayerPtr player);
+	Ball(GamefieldPtr mGamefield, ElementHandle mHandle, const Vector& mPosition, PlayerPtr player, int32_t mass);
 	~Ball();
 
 	const PlayerPtr& getPlayer() const { return mPlayer; }
 
 	virtual void setMass(uint32_t mass);
 
-	virtual bool tryEat(ElementPtr ptr);
+	//Eats Food, Shoots and smaller Balls
+	bool tryEat(Element& other);
+	bool tryEat(Ball& other);
 
 	BallPtr splitUp(const Vector& direction);
 
@@ -0,0 +1,74 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "Broadphase.h"
+#include "QuadTree.h"
+#include "WorkerPool.h"
+
+#include <cstring>
+#include <limits>
+
+void Broadphase::detect() {
+	for(TaskResult& result : mResults) {
+		result.pairs.clear();
+		result.pairTests = 0;
+		memset(result.dropped, 0, sizeof(result.dropped));
+	}
+
+	findCollisions();
+}
+
+void Broadphase::collectResult(const TaskResult& result) {
+	mPairTests += result.pairTests;
+	for(uint32_t i = 0; i < COLLISION_TYPES; i++)
+		for(uint32_t j = i; j < COLLISION_TYPES; j++)
+			mDropped[i][j] += result.dropped[i][j];
+}
+
+void Broadphase::collectPairTypes(PairTypeCounters& reported, PairTypeCounters& dropped) {
+	for(uint32_t i = 0; i < COLLISION_TYPES; i++) {
+		for(uint32_t j = 0; j < COLLISION_TYPES; j++) {
+			reported[i][j] += mReported[i][j];
+			dropped[i][j] += mDropped[i][j];
+		}
+	}
+	memset(mReported, 0, sizeof(mReported));
+	memset(mDropped, 0, sizeof(mDropped));
+}
+
+void Broadphase::queryCircle(const Vector& center, double radius, uint32_t types, QueryVisitor visitor) {
+	double radiusSquared = radius * radius;
+	queryRect(center - radius, center + radius, types, [&] (QuadTreeNodePtr elem) {
+		if(elem->getPosition().distanceSquared(center) <= radiusSquared)
+			visitor(elem);
+	});
+}
+
+size_t Broadphase::nearestK(const Vector& position, size_t k, uint32_t types, Nearest* result) {
+	size_t count = 0;
+	if(k == 0)
+		return 0;
+	double infinity = std::numeric_limits<double>::infinity();
+	queryRect(Vector(-infinity, -infinity), Vector(infinity, infinity), types, [&] (QuadTreeNodePtr elem) {
+		insertNearest(result, count, k, elem, elem->getPosition().distanceSquared(position));
+	});
+	return count;
+}
+
+void Broadphase::visitFound(size_t begin, QueryVisitor visitor) {
+	//Indexed, a nested query may grow the buffer, it shrinks it back to its own begin
+	for(size_t i = begin; i < mFound.size(); i++)
+		if(!mFound[i]->isDeleted())
+			visitor(mFound[i]);
+	mFound.resize(begin);
+}
+
+void Broadphase::runTasks(size_t count, const function<void (size_t, TaskResult&)>& task) {
+	//Results keep their buffers between the checks
+	if(mResults.size() < count)
+		mResults.resize(count);
+	WorkerPool::get().parallelFor(count, mThreads, [this, &task] (size_t i) {
+		task(i, mResults[i]);
+	});
+}
@@ -0,0 +1,171 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_BROADPHASE_H
+#define SERVER_BROADPHASE_H
+
+#include "GlobalDefs.h"
+#include "QuadTreeNode.h"
+
+#include <type_traits>
+
+typedef uint64_t PairTypeCounters[COLLISION_TYPES][COLLISION_TYPES];
+
+struct CollisionPair {
+	QuadTreeNodePtr e1;
+	QuadTreeNodePtr e2;
+};
+
+/*
+ * Reference to the visitor of a query. Unlike std::function the lambda is not copied,
+ * so passing one never allocates. Only valid during the query it is passed to.
+ */
+class QueryVisitor {
+private:
+	void* mFunc;
+	void (*mCall)(void*, QuadTreeNodePtr);
+
+	template<typename Func>
+	static void call(void* func, QuadTreeNodePtr elem) { (*(Func*) func)(elem); }
+
+public:
+	template<typename Func, typename = typename std::enable_if<!std::is_same<typename std::decay<Func>::type, QueryVisitor>::value>::type>
+	QueryVisitor(Func&& func) : mFunc((void*) &func), mCall(&call<typename std::remove_reference<Func>::type>) {}
+
+	void operator ()(QuadTreeNodePtr elem) const { mCall(mFunc, elem); }
+};
+
+/*
+ * Common interface of all collision broadphases.
+ * A Gamefield owns exactly one of them (selected by Options::collision.broadphase)
+ * and passes every intersecting pair to the visitor of doCollisionCheck.
+ *
+ * A check has two phases: the detection splits the work into tasks that may run on
+ * several threads and only collect pairs, then all pairs are passed to the visitor
+ * on the calling thread in task order. So the visitor may add or remove elements and
+ * the result does not depend on the number of threads.
+ */
+class Broadphase {
+public:
+	struct Nearest {
+		QuadTreeNodePtr elem;
+		//Squared distance of the centers
+		double distance;
+	};
+
+protected:
+	//Output of one detection task, only written by the thread running it
+	struct TaskResult {
+		vector<CollisionPair> pairs;
+		uint64_t pairTests = 0;
+		//Pairs dropped because their types can not interact
+		PairTypeCounters dropped = {};
+
+		void drop(uint8_t type1, uint8_t type2) { dropped[min(type1, type2)][max(type1, type2)]++; }
+	};
+
+	uint64_t mPairTests = 0;
+	//Elements that moved into another node / cell
+	uint64_t mRelocations = 0;
+	PairTypeCounters mReported = {};
+	PairTypeCounters mDropped = {};
+	//Threads used for the detection (0 = one per core)
+	size_t mThreads = 1;
+
+	//Found by the queries before they are visited, nested queries of a visitor use the part behind
+	vector<QuadTreeNodePtr> mFound;
+
+private:
+	vector<TaskResult> mResults;
+
+public:
+	virtual ~Broadphase() {}
+
+	virtual bool add(QuadTreeNodePtr elem) = 0;
+	virtual bool remove(QuadTreeNodePtr elem) = 0;
+	//Called whenever an element has moved
+	virtual void update(QuadTreeNodePtr elem) = 0;
+
+	//Calls visitor(e1, e2) for every intersecting pair. It is a template so the handler is
+	//inlined into the loop over the pairs
+	template<typename Visitor>
+	void doCollisionCheck(Visitor&& visitor);
+
+	void setThreads(size_t threads) { mThreads = threads; }
+
+	virtual size_t getElementCount() const = 0;
+	//Number of nodes / cells, only used for statistics
+	virtual size_t getChildCount() const = 0;
+	//Returns the number of narrowphase tests since the last call
+	virtual uint64_t collectPairTests() { uint64_t tests = mPairTests; mPairTests = 0; return tests; }
+	//Returns the number of relocations since the last call
+	uint64_t collectRelocations() { uint64_t relocations = mRelocations; mRelocations = 0; return relocations; }
+	//Adds the reported and dropped pairs per type pair since the last call
+	void collectPairTypes(PairTypeCounters& reported, PairTypeCounters& dropped);
+
+	virtual const char* getName() const = 0;
+
+	/*
+	 * Queries by the center of the elements, types is a mask of collision types (1 << type).
+	 * Elements that are marked as deleted are skipped. The visitor may add or remove elements.
+	 * Only call them from the simulation thread. Added elements are found after the next check,
+	 * the broadphases that only refit at the check find moved elements by their last check.
+	 * QuadTree, StaticIndex, LinearQuadTree and AABBTree search their structure, SpatialHash and
+	 * SweepAndPrune scan all elements. See Gamefield::queryRect for all elements of a lobby.
+	 */
+	//Calls visitor(elem) for every element with its center inside the rect from - to
+	virtual void queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor) = 0;
+	//Calls visitor(elem) for every element with its center inside the circle, by default the rect around it
+	virtual void queryCircle(const Vector& center, double radius, uint32_t types, QueryVisitor visitor);
+	//Fills result with the (up to) k nearest elements sorted by distance and returns their number.
+	//By default all elements are scanned, only QuadTree, StaticIndex and AABBTree search
+	virtual size_t nearestK(const Vector& position, size_t k, uint32_t types, Nearest* result);
+
+protected:
+	//Collects all intersecting pairs, implementations call runTasks for the parallel part
+	virtual void findCollisions() = 0;
+	//Clears the results of the last check and runs findCollisions
+	void detect();
+	//Adds the counters of a task to the totals
+	void collectResult(const TaskResult& result);
+	//Runs task(i, result) for i in [0, count), the results are resolved in this order
+	void runTasks(size_t count, const function<void (size_t, TaskResult&)>& task);
+
+	//Visits the elements found from begin on and drops them again
+	void visitFound(size_t begin, QueryVisitor visitor);
+
+	static bool matches(QuadTreeNodePtr elem, const Vector& from, const Vector& to, uint32_t types) {
+		const Vector& pos = elem->getPosition();
+		return (types & (1u << elem->getCollisionType())) && !elem->isDeleted() && pos.x >= from.x && pos.x <= to.x && pos.y >= from.y && pos.y <= to.y;
+	}
+	//Adds the element to the k nearest found so far if it is nearer than the last one
+	static void insertNearest(Nearest* result, size_t& count, size_t k, QuadTreeNodePtr elem, double distance) {
+		if(count == k && distance >= result[k - 1].distance)
+			return;
+		//Insertion sort, k is small
+		size_t i = count < k ? count++ : k - 1;
+		for(; i > 0 && result[i - 1].distance > distance; i--)
+			result[i] = result[i - 1];
+		result[i] = Nearest {elem, distance};
+	}
+};
+
+template<typename Visitor>
+void Broadphase::doCollisionCheck(Visitor&& visitor) {
+	detect();
+
+	//Elements eaten by an earlier pair are skipped
+	for(TaskResult& result : mResults) {
+		collectResult(result);
+		for(CollisionPair& pair : result.pairs) {
+			if(pair.e1->isDeleted() || pair.e2->isDeleted()) continue;
+			uint8_t type1 = pair.e1->getCollisionType(), type2 = pair.e2->getCollisionType();
+			mReported[min(type1, type2)][max(type1, type2)]++;
+			visitor(pair.e1, pair.e2);
+		}
+	}
+}
+
+
+#endif //SERVER_BROADPHASE_H
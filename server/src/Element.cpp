@@ -3,11 +3,14 @@
 //
 
 #include "Element.h"
+#include "Gamefield.h"
+
+static const String NO_NAME;
 
 ElementData Element::get() const {
-	return ElementData {mId, getType(), mColor, "", mPosition.x, mPosition.y, mSize};
+	return ElementData {getId(), getType(), &mGamefield->getColors().get(mColor), &NO_NAME, mPosition.x, mPosition.y, mSize};
 }
 
 ElementUpdateData Element::getUpdate() const {
-	return ElementUpdateData {mId, mPosition.x, mPosition.y, mSize, 0, 0 };
+	return ElementUpdateData {getId(), mPosition.x, mPosition.y, mSize, 0, 0 };
 }
@@ -8,6 +8,7 @@
 #include "GlobalDefs.h"
 #include "Vector.h"
 #include "QuadTree.h"
+#include "ElementHandle.h"
 
 enum ElementType : int8_t {
 	ET_Ball,
@@ -17,11 +18,33 @@ enum ElementType : int8_t {
 	ET_Item
 };
 
+constexpr uint32_t getTypeBit(ElementType type) { return 1u << type; }
+
+//Types an element can interact with (see Gamefield::doIntersect), the broadphases drop all other pairs before the exact test
+constexpr uint32_t getInteractionMask(ElementType type) {
+	return type == ET_Ball ? getTypeBit(ET_Ball) | getTypeBit(ET_Food) | getTypeBit(ET_Shoot) | getTypeBit(ET_Obstracle) | getTypeBit(ET_Item) :
+		   type == ET_Shoot ? getTypeBit(ET_Ball) | getTypeBit(ET_Obstracle) :
+		   type == ET_Obstracle ? getTypeBit(ET_Ball) | getTypeBit(ET_Shoot) :
+		   getTypeBit(ET_Ball); //Food and Items are only eaten by / eat Balls
+}
+
+constexpr bool canInteract(ElementType a, ElementType b) { return (getInteractionMask(a) & getTypeBit(b)) != 0; }
+
+//Every pair of types is checked only once, so the matrix has to be symmetric
+constexpr bool isInteractionSymmetric(int a = 0, int b = 0) {
+	return a > ET_Item ? true :
+		   b > ET_Item ? isInteractionSymmetric(a + 1, 0) :
+		   canInteract((ElementType) a, (ElementType) b) == canInteract((ElementType) b, (ElementType) a) && isInteractionSymmetric(a, b + 1);
+}
+static_assert(isInteractionSymmetric(), "Element interaction matrix is not symmetric");
+static_assert(ET_Item < COLLISION_TYPES, "Too many element types for the broadphase counters");
+
+//Color and name point into the Palettes of the Gamefield
 struct ElementData {
 	uint32_t id;
 	ElementType type;
-	String color;
-	String name;
+	const String* color;
+	const String* name;
 	double x;
 	double y;
 	double size;
@@ -37,28 +60,36 @@ struct ElementUpdateData {
 };
 
 class Element : public QuadTreeNode {
-	//friend class Gamefield;
+friend class Gamefield;
 
 protected:
 	GamefieldPtr mGamefield;
-	uint32_t mId;
-	String mColor;
+	ElementHandle mHandle;
+	//Index in the colors of the Gamefield
+	uint16_t mColor;
 	uint32_t mMass;
 
 private:
 	bool mHasChanged = false;
+	//Index in Gamefield::mElements, so it is removed without a search
+	uint32_t mIndex = 0;
 
 public:
-	Element(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition, const String& mColor, double mSize,
+	Element(GamefieldPtr mGamefield, ElementHandle mHandle, const Vector& mPosition, uint16_t mColor, double mSize,
 			uint32_t mMass = 0) :
 			QuadTreeNode(mPosition, mSize),
-			mGamefield(mGamefield), mId(mId), mColor(mColor), mMass(mMass) { }
-	virtual ~Element() { /*printf("Element(%s) %d Destruct at %.0lf, %.0lf\n", mColor.c_str(), mId, mPosition.x, mPosition.y);*/ }
+			mGamefield(mGamefield), mHandle(mHandle), mColor(mColor), mMass(mMass) { }
+	virtual ~Element() { /*printf("Element(%d) %d Destruct at %.0lf, %.0lf\n", mColor, getId(), mPosition.x, mPosition.y);*/ }
+
 
+	ElementHandle getHandle() const { return mHandle; }
+	//Id of the network protocol
+	uint32_t getId() const { return mHandle.getValue(); }
 
-	uint32_t getId() const { return mId; }
+	Gamefield& getGamefield() const { return *mGamefield; }
 
-	virtual bool tryEat(ElementPtr other) { return false; }
+	//Owning pointer, only needed when the element is stored somewhere (e.g. on destruction)
+	ElementPtr getPtr() { return std::static_pointer_cast<Element>(shared_from_this()); }
 
 	void setSize(double size) {	mSize = size; }
 
@@ -70,6 +101,9 @@ public:
 
 	virtual double getSpeed() const { return 0; }
 
+	//Elements that never move are kept in the StaticIndex
+	virtual bool isMoveable() const { return false; }
+
 	virtual void update(double /*timediff*/) { mHasChanged = false; }
 
 	virtual ElementType getType() const = 0;
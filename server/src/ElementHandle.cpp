@@ -0,0 +1,65 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "ElementHandle.h"
+#include "Element.h"
+
+#include <stdexcept>
+
+ElementHandle ElementTable::acquire() {
+	lock_guard<mutex> _lock(mMutex);
+	if(!mFree.empty()) {
+		uint32_t index = mFree.back();
+		mFree.pop_back();
+		return ElementHandle(index, mSlots[index].generation);
+	}
+	if(mSlots.size() > ElementHandle::MAX_INDEX)
+		throw std::runtime_error("Element table is full");
+	mSlots.push_back(Slot {NULL, 1});
+	return ElementHandle((uint32_t) mSlots.size() - 1, 1);
+}
+
+void ElementTable::set(ElementHandle handle, Element* element) {
+	lock_guard<mutex> _lock(mMutex);
+	assert(handle.getIndex() < mSlots.size() && mSlots[handle.getIndex()].generation == handle.getGeneration());
+	mSlots[handle.getIndex()].element = element;
+}
+
+void ElementTable::release(ElementHandle handle) {
+	lock_guard<mutex> _lock(mMutex);
+	uint32_t index = handle.getIndex();
+	if(index >= mSlots.size() || mSlots[index].generation != handle.getGeneration()) {
+		fprintf(stderr, "Element handle %u is released twice\n", handle.getValue());
+		return;
+	}
+	Slot& slot = mSlots[index];
+	slot.element = NULL;
+	//A retired slot keeps its last generation, so old handles still do not resolve
+	if(slot.generation == ElementHandle::MAX_GENERATION)
+		return;
+	slot.generation++;
+	mFree.push_back(index);
+}
+
+Element* ElementTable::get(ElementHandle handle) {
+	lock_guard<mutex> _lock(mMutex);
+	uint32_t index = handle.getIndex();
+	if(index >= mSlots.size() || mSlots[index].generation != handle.getGeneration())
+		return NULL;
+	return mSlots[index].element;
+}
+
+ElementPtr ElementTable::lock(ElementHandle handle) {
+	lock_guard<mutex> _lock(mMutex);
+	uint32_t index = handle.getIndex();
+	if(index >= mSlots.size() || mSlots[index].generation != handle.getGeneration() || !mSlots[index].element)
+		return ElementPtr();
+	//The Gamefield still owns it, the slot is released before the element is removed from its list
+	return mSlots[index].element->getPtr();
+}
+
+size_t ElementTable::getSlotCount() {
+	lock_guard<mutex> _lock(mMutex);
+	return mSlots.size();
+}
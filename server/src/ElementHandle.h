@@ -0,0 +1,72 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_ELEMENTHANDLE_H
+#define SERVER_ELEMENTHANDLE_H
+
+#include "GlobalDefs.h"
+
+/*
+ * Identity of an element: its slot in the ElementTable of the Gamefield and the generation of
+ * that slot. The slot is reused after the element is destroyed, the generation is not, so
+ * handles of destroyed elements are detected without keeping them alive.
+ * The value is the element id of the network protocol.
+ */
+class ElementHandle {
+public:
+	static const uint32_t INDEX_BITS = 20;
+	static const uint32_t MAX_INDEX = (1u << INDEX_BITS) - 1;
+	static const uint32_t MAX_GENERATION = (1u << (32 - INDEX_BITS)) - 1;
+
+private:
+	uint32_t mValue = 0;
+
+public:
+	//Generations start at 1, so the default handle is never valid
+	ElementHandle() {}
+	ElementHandle(uint32_t index, uint32_t generation) : mValue(generation << INDEX_BITS | index) {}
+
+	uint32_t getIndex() const { return mValue & MAX_INDEX; }
+	uint32_t getGeneration() const { return mValue >> INDEX_BITS; }
+	uint32_t getValue() const { return mValue; }
+
+	bool isValid() const { return mValue != 0; }
+
+	bool operator ==(const ElementHandle& other) const { return mValue == other.mValue; }
+	bool operator !=(const ElementHandle& other) const { return mValue != other.mValue; }
+};
+
+/*
+ * Dense table from the handle index to the element. Freed slots are reused with the next generation,
+ * a slot whose generation is used up is retired, so a handle value is never given out twice.
+ * Handles are created and resolved on the network threads too, so it is locked.
+ */
+class ElementTable {
+private:
+	struct Slot {
+		Element* element;
+		uint32_t generation;
+	};
+
+	mutex mMutex;
+	vector<Slot> mSlots;
+	vector<uint32_t> mFree;
+
+public:
+	//New handle, resolves to NULL until the element is set
+	ElementHandle acquire();
+	void set(ElementHandle handle, Element* element);
+	//The handle and all copies of it resolve to NULL from now on
+	void release(ElementHandle handle);
+
+	//NULL if the element was destroyed
+	Element* get(ElementHandle handle);
+	//Like get, but the element can not be freed while the pointer is held
+	ElementPtr lock(ElementHandle handle);
+
+	size_t getSlotCount();
+};
+
+
+#endif //SERVER_ELEMENTHANDLE_H
@@ -0,0 +1,50 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "ElementPool.h"
+
+ElementPool::~ElementPool() {
+	for(void* block : mFree)
+		::operator delete(block);
+}
+
+void* ElementPool::allocate(size_t size) {
+	{
+		lock_guard<mutex> _lock(mMutex);
+		if(mBlockSize == 0)
+			mBlockSize = size;
+		if(size == mBlockSize && !mFree.empty()) {
+			void* block = mFree.back();
+			mFree.pop_back();
+			mHits++;
+			return block;
+		}
+		mMisses++;
+	}
+	return ::operator new(size);
+}
+
+void ElementPool::deallocate(void* block, size_t size) {
+	{
+		lock_guard<mutex> _lock(mMutex);
+		if(size == mBlockSize) {
+			mFree.push_back(block);
+			return;
+		}
+	}
+	::operator delete(block);
+}
+
+void ElementPool::collectStats(uint64_t& hits, uint64_t& misses) {
+	lock_guard<mutex> _lock(mMutex);
+	hits += mHits;
+	misses += mMisses;
+	mHits = 0;
+	mMisses = 0;
+}
+
+size_t ElementPool::getFreeCount() {
+	lock_guard<mutex> _lock(mMutex);
+	return mFree.size();
+}
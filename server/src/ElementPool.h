@@ -0,0 +1,72 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_ELEMENTPOOL_H
+#define SERVER_ELEMENTPOOL_H
+
+#include "GlobalDefs.h"
+
+/*
+ * Free list for the elements of one type in one Gamefield. Blocks are only returned to the heap
+ * when the pool is destroyed, so once a lobby reached its usual number of elements creating and
+ * destroying them does not allocate any more.
+ * Elements are also created on the network threads (e.g. by a split), so it is locked.
+ */
+class ElementPool {
+private:
+	mutex mMutex;
+	//Size of the first allocation, all blocks of a pool have the same size
+	size_t mBlockSize = 0;
+	vector<void*> mFree;
+	uint64_t mHits = 0;
+	uint64_t mMisses = 0;
+
+public:
+	~ElementPool();
+
+	void* allocate(size_t size);
+	void deallocate(void* block, size_t size);
+
+	//Adds the allocations since the last call that were / were not served from the free list
+	void collectStats(uint64_t& hits, uint64_t& misses);
+	size_t getFreeCount();
+};
+
+/*
+ * Allocator for std::allocate_shared, so the element and the control block of its shared_ptr
+ * are one block of the pool. Every copy keeps the pool alive until the last element is freed.
+ */
+template<typename T>
+class PoolAllocator {
+template<typename U> friend class PoolAllocator;
+private:
+	ElementPoolPtr mPool;
+
+public:
+	typedef T value_type;
+
+	PoolAllocator(const ElementPoolPtr& mPool) : mPool(mPool) {}
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>& other) : mPool(other.mPool) {}
+
+	T* allocate(size_t n) {
+		if(n != 1)
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+		return static_cast<T*>(mPool->allocate(sizeof(T)));
+	}
+	void deallocate(T* p, size_t n) {
+		if(n != 1)
+			::operator delete(p);
+		else
+			mPool->deallocate(p, sizeof(T));
+	}
+
+	template<typename U>
+	bool operator ==(const PoolAllocator<U>& other) const { return mPool == other.mPool; }
+	template<typename U>
+	bool operator !=(const PoolAllocator<U>& other) const { return mPool != other.mPool; }
+};
+
+
+#endif //SERVER_ELEMENTPOOL_H
@@ -0,0 +1,181 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "ElementStore.h"
+#include "MoveableElement.h"
+
+void ElementStore::add(MoveableElement* elem) {
+	queue(Command {elem->getHandle(), C_Add, false, Vector::ZERO, 0});
+}
+
+void ElementStore::remove(MoveableElement* elem) {
+	Table& table = mTables[elem->mType];
+	uint32_t slot = elem->mSlot;
+	if(slot >= table.size() || table.elements[slot] != elem) {
+		fprintf(stderr, "Element %d is not in the store\n", elem->getId());
+		return;
+	}
+	//Swap with last element then pop last
+	size_t last = table.size() - 1;
+	table.elements[slot] = table.elements[last];
+	table.elements[slot]->mSlot = slot;
+	table.x[slot] = table.x[last];
+	table.y[slot] = table.y[last];
+	table.velX[slot] = table.velX[last];
+	table.velY[slot] = table.velY[last];
+	table.dirX[slot] = table.dirX[last];
+	table.dirY[slot] = table.dirY[last];
+	table.boostX[slot] = table.boostX[last];
+	table.boostY[slot] = table.boostY[last];
+	table.boostAcceleration[slot] = table.boostAcceleration[last];
+	table.boostFactor[slot] = table.boostFactor[last];
+	table.maxSpeed[slot] = table.maxSpeed[last];
+	table.flags[slot] = table.flags[last];
+
+	table.elements.pop_back();
+	table.x.pop_back();
+	table.y.pop_back();
+	table.velX.pop_back();
+	table.velY.pop_back();
+	table.dirX.pop_back();
+	table.dirY.pop_back();
+	table.boostX.pop_back();
+	table.boostY.pop_back();
+	table.boostAcceleration.pop_back();
+	table.boostFactor.pop_back();
+	table.maxSpeed.pop_back();
+	table.flags.pop_back();
+	elem->mSlot = MoveableElement::NO_SLOT;
+}
+
+void ElementStore::setDirection(MoveableElement* elem, const Vector& direction, bool isMoving) {
+	queue(Command {elem->getHandle(), C_Direction, isMoving, direction, 0});
+}
+
+void ElementStore::setBoost(MoveableElement* elem, const Vector& velocity, double acceleration) {
+	queue(Command {elem->getHandle(), C_Boost, false, velocity, acceleration});
+}
+
+void ElementStore::setBoostFactor(MoveableElement* elem, double boost) {
+	queue(Command {elem->getHandle(), C_BoostFactor, false, Vector::ZERO, boost});
+}
+
+void ElementStore::setMaxSpeed(MoveableElement* elem, double speed) {
+	queue(Command {elem->getHandle(), C_MaxSpeed, false, Vector::ZERO, speed});
+}
+
+void ElementStore::queue(const Command& command) {
+	lock_guard<mutex> _lock(mMutex);
+	mCommands.push_back(command);
+}
+
+void ElementStore::apply(const Command& command, MoveableElement* elem) {
+	Table& table = mTables[elem->mType];
+	uint32_t slot = elem->mSlot;
+	if(command.type == C_Add) {
+		if(slot != MoveableElement::NO_SLOT)
+			return;
+		elem->mSlot = (uint32_t) table.size();
+		table.elements.push_back(elem);
+		table.x.push_back(elem->getPosition().x);
+		table.y.push_back(elem->getPosition().y);
+		table.velX.push_back(0);
+		table.velY.push_back(0);
+		table.dirX.push_back(0);
+		table.dirY.push_back(0);
+		table.boostX.push_back(elem->mStartBoost.x);
+		table.boostY.push_back(elem->mStartBoost.y);
+		table.boostAcceleration.push_back(elem->mStartBoostAcceleration);
+		table.boostFactor.push_back(1);
+		table.maxSpeed.push_back(elem->mStartSpeed);
+		table.flags.push_back(0);
+		return;
+	}
+	//Removed from the store, but not yet from the ElementTable
+	if(slot == MoveableElement::NO_SLOT)
+		return;
+	switch(command.type) {
+		case C_Direction:
+			if(command.moving)
+				table.flags[slot] |= F_Moving;
+			else
+				table.flags[slot] &= ~F_Moving;
+			table.dirX[slot] = command.value.x;
+			table.dirY[slot] = command.value.y;
+			break;
+		case C_Boost:
+			table.boostX[slot] = command.value.x;
+			table.boostY[slot] = command.value.y;
+			table.boostAcceleration[slot] = command.amount;
+			break;
+		case C_BoostFactor:
+			table.boostFactor[slot] = command.amount;
+			break;
+		case C_MaxSpeed:
+			table.maxSpeed[slot] = command.amount;
+			break;
+		default:
+			break;
+	}
+}
+
+void ElementStore::integrate(double timediff, double acceleration, const Vector& size, ElementTable& elements) {
+	{
+		lock_guard<mutex> _lock(mMutex);
+		mApplying.swap(mCommands);
+	}
+	//Elements destroyed since the command was queued resolve to NULL
+	for(const Command& command : mApplying) {
+		Element* elem = elements.get(command.handle);
+		if(elem)
+			apply(command, static_cast<MoveableElement*>(elem));
+	}
+	mApplying.clear();
+
+	for(Table& table : mTables)
+		integrate(table, timediff, acceleration, size);
+}
+
+void ElementStore::integrate(Table& table, double timediff, double acceleration, const Vector& size) {
+	//Same rules as before per element: the boost and the velocity without a direction slow down
+	//with a constant deceleration, the velocity follows the direction up to the max speed
+	double a = acceleration * timediff;
+	for(size_t i = 0; i < table.size(); i++) {
+		uint8_t flags = table.flags[i] & ~F_Changed;
+
+		if(table.boostX[i] != 0 || table.boostY[i] != 0) {
+			double bx = table.boostX[i], by = table.boostY[i];
+			double velX = bx - table.boostAcceleration[i] * timediff * sign(bx);
+			double velY = by - table.boostAcceleration[i] * timediff * sign(by);
+			table.boostX[i] = sign(velX) == sign(bx) ? velX : 0;
+			table.boostY[i] = sign(velY) == sign(by) ? velY : 0;
+			flags |= F_Changed;
+		}
+
+		double vx = table.velX[i], vy = table.velY[i];
+		if(flags & F_Moving) {
+			double limit = table.maxSpeed[i] * table.boostFactor[i];
+			double velX = table.dirX[i] * a + vx, velY = table.dirY[i] * a + vy;
+			table.velX[i] = fabs(velX) > fabs(limit * table.dirX[i]) ? limit * table.dirX[i] : velX;
+			table.velY[i] = fabs(velY) > fabs(limit * table.dirY[i]) ? limit * table.dirY[i] : velY;
+			flags |= F_Changed;
+		} else if(vx != 0 || vy != 0) {
+			double velX = vx - a * sign(vx), velY = vy - a * sign(vy);
+			table.velX[i] = sign(velX) == sign(vx) ? velX : 0;
+			table.velY[i] = sign(velY) == sign(vy) ? velY : 0;
+			flags |= F_Changed;
+		}
+
+		if(flags & F_Changed) {
+			//do not let them move outside the gamefield
+			table.x[i] = min(max(table.x[i] + (table.velX[i] + table.boostX[i]) * timediff, 0.), size.x);
+			table.y[i] = min(max(table.y[i] + (table.velY[i] + table.boostY[i]) * timediff, 0.), size.y);
+		}
+		table.flags[i] = flags;
+	}
+
+	//Also the ones that did not move, their sweep is reset
+	for(size_t i = 0; i < table.size(); i++)
+		table.elements[i]->moved(Vector(table.x[i], table.y[i]), (table.flags[i] & F_Changed) != 0);
+}
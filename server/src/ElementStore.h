@@ -0,0 +1,102 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_ELEMENTSTORE_H
+#define SERVER_ELEMENTSTORE_H
+
+#include "GlobalDefs.h"
+#include "Vector.h"
+#include "Element.h"
+#include "ElementHandle.h"
+
+class MoveableElement;
+
+/*
+ * Movement state of all MoveableElements with one array per field, grouped by the ElementType.
+ * The elements only keep their slot, so the movement of a whole type is computed in one
+ * linear pass (see integrate) instead of a virtual call per element.
+ *
+ * Only the simulation thread reads and writes the arrays, without a lock. Elements are also
+ * created and steered from the network threads, these changes are queued with the handle of
+ * the element and applied at the start of the next integrate, when they would take effect anyway.
+ *
+ * Size stays in the QuadTreeNode, the broadphases read it from there and keep their own packed
+ * arrays. Mass stays on Element, Food and Items have one too and never move. The x/y arrays are
+ * the integrated positions, integrate copies them into the QuadTreeNode for the broadphases.
+ */
+class ElementStore {
+public:
+	enum Flags : uint8_t {
+		F_Moving = 1,
+		//Moved in the last integrate
+		F_Changed = 2
+	};
+
+	struct Table {
+		vector<MoveableElement*> elements;
+		vector<double> x;
+		vector<double> y;
+		vector<double> velX;
+		vector<double> velY;
+		vector<double> dirX;
+		vector<double> dirY;
+		vector<double> boostX;
+		vector<double> boostY;
+		vector<double> boostAcceleration;
+		vector<double> boostFactor;
+		vector<double> maxSpeed;
+		vector<uint8_t> flags;
+
+		size_t size() const { return elements.size(); }
+	};
+
+private:
+	enum CommandType : uint8_t {
+		C_Add,
+		C_Direction,
+		C_Boost,
+		C_BoostFactor,
+		C_MaxSpeed
+	};
+	struct Command {
+		ElementHandle handle;
+		CommandType type;
+		bool moving;
+		Vector value;
+		double amount;
+	};
+
+	Table mTables[ET_Item + 1];
+	//Changes from any thread, applied by the next integrate
+	vector<Command> mCommands;
+	vector<Command> mApplying;
+	mutex mMutex;
+
+public:
+	//The element gets its row with its start values in the next integrate
+	void add(MoveableElement* elem);
+	//Only from the simulation thread
+	void remove(MoveableElement* elem);
+
+	//From any thread, applied in the next integrate
+	void setDirection(MoveableElement* elem, const Vector& direction, bool isMoving);
+	void setBoost(MoveableElement* elem, const Vector& velocity, double acceleration);
+	void setBoostFactor(MoveableElement* elem, double boost);
+	void setMaxSpeed(MoveableElement* elem, double speed);
+
+	//Applies the queued changes of the elements that still exist and moves all elements,
+	//the ones that moved get their new position and are marked as changed
+	void integrate(double timediff, double acceleration, const Vector& size, ElementTable& elements);
+
+	//Only from the simulation thread
+	const Table& getTable(ElementType type) const { return mTables[type]; }
+
+private:
+	void queue(const Command& command);
+	void apply(const Command& command, MoveableElement* elem);
+	void integrate(Table& table, double timediff, double acceleration, const Vector& size);
+};
+
+
+#endif //SERVER_ELEMENTSTORE_H
@@ -5,8 +5,8 @@
 #include "Food.h"
 #include "Gamefield.h"
 
-Food::Food(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition) :
-		Element(mGamefield, mId, mPosition, mGamefield->getOptions().food.color, mGamefield->getOptions().food.size,
+Food::Food(GamefieldPtr mGamefield, ElementHandle mHandle, const Vector& mPosition, uint16_t mColor) :
+		Element(mGamefield, mHandle, mPosition, mColor, mGamefield->getOptions().food.size,
 				mGamefield->getOptions().food.mass) {
 
 }
@@ -11,7 +11,7 @@
 class Food : public Element {
 
 public:
-	Food(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition);
+	Food(GamefieldPtr mGamefield, ElementHandle mHandle, const Vector& mPosition, uint16_t mColor);
 
 	virtual ElementType getType() const { return ET_Food; }
 };
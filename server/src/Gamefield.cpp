@@ -13,16 +13,44 @@
 #include "Network/Server.h"
 #include "Network/AgarPackets.h"
 #include "QuadTree.h"
+#include "SpatialHash.h"
+#include "SweepAndPrune.h"
+#include "LinearQuadTree.h"
+#include "AABBTree.h"
 #include "Item.h"
 
 #include <thread>
+#include <cstring>
 
 using std::placeholders::_1;
 using std::placeholders::_2;
 
-Gamefield::Gamefield(ServerPtr server, const String& name, const Options&  options) : mServer(server), mName(name), mOptions(options) {
-	//mQuadTree = make_shared<QuadTree>(Vector(0,0), Vector(mOptions.width,  mOptions.height), std::bind(&Gamefield::doIntersect, this, _1, _2));
-	mQuadTree = new QuadTree(Vector(0,0), Vector(mOptions.width,  mOptions.height), std::bind(&Gamefield::doIntersect, this, _1, _2));
+//All colors of the options, the palette is not changed afterwards
+static vector<String> getOptionColors(const Options& options) {
+	vector<String> colors = { options.food.color, options.obstracle.color, options.item.color };
+	colors.insert(colors.end(), options.player.color.begin(), options.player.color.end());
+	return colors;
+}
+
+Gamefield::Gamefield(ServerPtr server, const String& name, const Options&  options) : mServer(server), mName(name), mOptions(options),
+		mColors(getOptionColors(mOptions)) {
+	for(ElementPoolPtr& pool : mPools)
+		pool = make_shared<ElementPool>();
+	mFoodColor = mColors.indexOf(mOptions.food.color);
+	mObstracleColor = mColors.indexOf(mOptions.obstracle.color);
+	mItemColor = mColors.indexOf(mOptions.item.color);
+	for(const String& color : mOptions.player.color)
+		mPlayerColors.push_back(mColors.indexOf(color));
+	mBroadphase.reset(createBroadphase());
+	mBroadphase->setThreads(mOptions.collision.threads);
+	if(mOptions.collision.staticIndex) {
+		mStaticIndex.reset(new StaticIndex(Vector(mOptions.width, mOptions.height), getCellSize()));
+		mStaticIndex->setThreads(mOptions.collision.threads);
+	}
+	if(mOptions.collision.continuous) {
+		mSweepIndex.reset(new SweepIndex(Vector(mOptions.width, mOptions.height), getCellSize()));
+		mSweepIndex->setThreads(mOptions.collision.threads);
+	}
 }
 
 
@@ -33,54 +61,94 @@ Gamefield::~Gamefield() {
 }
 
 BallPtr Gamefield::createBall(PlayerPtr const&  player, const Vector& position) {
-	BallPtr b = make_shared<Ball>(shared_from_this(), mElementIds++, position, player);
+	BallPtr b = allocateElement<Ball>(ET_Ball, position, player);
 	addElement(b);
 	return b;
 }
 
-ShootPtr Gamefield::createShoot(const Vector& pos, const String& color, const Vector& direction) {
-	ShootPtr s = make_shared<Shoot>(shared_from_this(), mElementIds++, pos, color, direction);
+ShootPtr Gamefield::createShoot(const Vector& pos, uint16_t color, const Vector& direction) {
+	ShootPtr s = allocateElement<Shoot>(ET_Shoot, pos, color, direction);
 	addElement(s);
 	return s;
 }
 
 
 ObstraclePtr Gamefield::createObstracle(const Vector& position) {
-	ObstraclePtr o = std::make_shared<Obstracle>(shared_from_this(), mElementIds++, position);
+	ObstraclePtr o = allocateElement<Obstracle>(ET_Obstracle, position, mObstracleColor);
 	addElement(o);
 	mObstracleCounter++;
 	return o;
 }
 
 
-void Gamefield::destroyElement(ElementPtr const&  elem) {
-	if(elem->isDeleted()) {
-		fprintf(stderr, "Dubble destory of element!!!!!! %d %p\n", elem->getId(), elem.get());
+void Gamefield::destroyElement(Element& elem) {
+	if(elem.isDeleted()) {
+		fprintf(stderr, "Dubble destory of element!!!!!! %d %p\n", elem.getId(), &elem);
 		assert(false);
 		return;
 	}
-	//printf("Maring as Deleted %d %p\n", elem->getId(), elem.get());
-	elem->markDeleted();
+	//printf("Maring as Deleted %d %p\n", elem.getId(), &elem);
+	elem.markDeleted();
 	{
 		lock_guard<mutex> _lock(mMutexDeletedElements);
-		mDeletedElements.push_back(elem);
+		mDeletedElements.push_back(&elem);
 	}
 
-	if (elem->getType() == ET_Ball) {
-		auto ball = std::dynamic_pointer_cast<Ball>(elem);
-		ball->getPlayer()->removeBall(ball->getId());
+	if (elem.getType() == ET_Ball) {
+		Ball& ball = static_cast<Ball&>(elem);
+		ball.getPlayer()->removeBall(ball.getHandle());
 	}
-	if (elem->getType() == ET_Food)
+	if (elem.getType() == ET_Food)
 		mFoodCounter--;
-	else if (elem->getType() == ET_Obstracle)
+	else if (elem.getType() == ET_Obstracle)
 		mObstracleCounter--;
-	else if (elem->getType() == ET_Item)
+	else if (elem.getType() == ET_Item)
 		mItemCounter--;
 }
 
+void Gamefield::queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor) {
+	mBroadphase->queryRect(from, to, types, visitor);
+	//Food and Items are only in the static index
+	if (mStaticIndex)
+		mStaticIndex->queryRect(from, to, types, visitor);
+}
+
+void Gamefield::queryCircle(const Vector& center, double radius, uint32_t types, QueryVisitor visitor) {
+	mBroadphase->queryCircle(center, radius, types, visitor);
+	if (mStaticIndex)
+		mStaticIndex->queryCircle(center, radius, types, visitor);
+}
+
+size_t Gamefield::nearestK(const Vector& position, size_t k, uint32_t types, Broadphase::Nearest* result) {
+	size_t count = mBroadphase->nearestK(position, k, types, result);
+	if (!mStaticIndex)
+		return count;
+	//Both lists are sorted, merged from the back into result
+	vector<Broadphase::Nearest>& statics = mNearest;
+	statics.resize(max(statics.size(), k));
+	size_t staticCount = mStaticIndex->nearestK(position, k, types, statics.data());
+	size_t total = min(count + staticCount, k);
+	size_t dropped = count + staticCount - total;
+	//The farthest ones that do not fit are skipped first
+	for (; dropped; dropped--) {
+		if (staticCount && (!count || statics[staticCount - 1].distance >= result[count - 1].distance))
+			staticCount--;
+		else
+			count--;
+	}
+	for (size_t i = total; i > 0; i--) {
+		if (staticCount && (!count || statics[staticCount - 1].distance >= result[count - 1].distance))
+			result[i - 1] = statics[--staticCount];
+		else
+			result[i - 1] = result[--count];
+	}
+	return total;
+}
+
 
 void Gamefield::sendToAll(PacketPtr packet) {
-	for(ClientPtr c : mClients)
+	lock_guard<mutex> _lock(mMutexPlayer);
+	for(const ClientPtr& c : mClients)
 		c->emit(packet);
 }
 
@@ -89,33 +157,26 @@ Vector Gamefield::generatePos() {
 }
 
 
-void Gamefield::_destroyElement(ElementPtr const&  elem) {
-	//Remove Element from QuadTree
-	if(elem->getRegion()) {
-		if (!elem->getRegion()->remove(elem.get())) {
-			fprintf(stderr, "Elem is not inside its own Region %d %p\n", elem->getId(), elem.get());
-			if (!mQuadTree->remove(elem.get()))
-				fprintf(stderr, "Remove from QuadTree failed for %d %p\n", elem->getId(), elem.get());
-		}
-	} else
-	if(!mQuadTree->remove(elem.get()))
-		fprintf(stderr, "Remove2 from QuadTree failed for %d %p\n", elem->getId(), elem.get());
-	elem->setRegion(NULL);
+void Gamefield::_destroyElement(Element* elem) {
+	//Remove Element from Broadphase
+	BroadphasePtr broadphase = elem->getBroadphase();
+	if(!broadphase || !broadphase->remove(elem))
+		fprintf(stderr, "Remove from %s failed for %d %p\n", broadphase ? broadphase->getName() : "none", elem->getId(), elem);
+	if(elem->isMoveable())
+		static_cast<MoveableElement*>(elem)->removeFromStore();
+	//The delete packet is sent, the handle may be reused
+	mElementTable.release(elem->getHandle());
 
 	lock_guard<mutex> _lock(mMutexElements);
 
-	//Find element
-	auto it = mElements.begin();
-	while (it != mElements.end()) {
-		if ((*it)->getId() == elem->getId())
-			break;
-		it++;
-	}
-	if (it != mElements.end()) {
-		//Swap with last element then pop last (no realocation needed)
-		(*it) = mElements.back();
+	uint32_t index = elem->mIndex;
+	if (index < mElements.size() && mElements[index].get() == elem) {
+		//Swap with last element then pop last (no realocation needed), this frees the element
+		mElements[index] = mElements.back();
+		mElements[index]->mIndex = index;
 		mElements.pop_back();
-	}
+	} else
+		fprintf(stderr, "Element %d is not in the element list\n", elem->getId());
 }
 
 void Gamefield::startUpdater() {
@@ -128,6 +189,8 @@ void Gamefield::startUpdater() {
 		createFood();
 
 	printf("Creating new thread\n");
+	//Set before the thread runs, otherwise the next join would wait for the new thread
+	mUpdaterRunning = true;
 	mUpdaterThread = (std::thread(std::bind(&Gamefield::updateLoop, this)));
 }
 
@@ -135,8 +198,7 @@ void Gamefield::updateLoop() {
 	using namespace std::chrono;
 	using timer=std::chrono::high_resolution_clock;
 
-	mUpdaterRunning = true;
-	timer::duration fps(microseconds((uint64_t)(1e6 /  30)));
+	timer::duration fps(microseconds((uint64_t)(1e6 / mOptions.tickRate)));
 
 	printf("Updater started %lf\n",  duration_cast<duration<double, std::milli> >(fps).count());
 
@@ -182,25 +244,45 @@ void Gamefield::update(double timediff) {
 	timer::duration timerCollision, timerUpdate;
 
 	{
-		vector<ElementPtr> changed;
+		vector<Element*> changed;
+		mMovingElements.clear();
+		mSweptElements.clear();
+		mAllElements.clear();
 		{
-			//lock_guard<mutex> _lock(mMutexElements);
+			mElementStore.integrate(timediff, mOptions.player.acceleration, Vector(mOptions.width, mOptions.height), mElementTable);
+			//The network threads add Balls meanwhile
+			lock_guard<mutex> _lock(mMutexElements);
 			for (ElementPtr& e : mElements) {
 				e->update(timediff);
 				if (e->hasChanged())
-					changed.push_back(e);
+					changed.push_back(e.get());
+				if (mStaticIndex && e->isMoveable())
+					mMovingElements.push_back(e.get());
+				if (mSweepIndex) {
+					mAllElements.push_back(e.get());
+					if (e->isSwept())
+						mSweptElements.push_back(e.get());
+				}
 			}
 		}
 
 		timerUpdate = timer::now().time_since_epoch() - timerStart;
 
 		//checkCollisions(timediff);
-		mQuadTree->doCollisionCheck();
+		auto intersect = [this] (QuadTreeNodePtr e1, QuadTreeNodePtr e2) { doIntersect(e1, e2); };
+		mBroadphase->doCollisionCheck(intersect);
+		if (mStaticIndex)
+			mStaticIndex->doCollisionCheck(mMovingElements, intersect);
+		if (mSweepIndex)
+			mSweepIndex->doCollisionCheck(mSweptElements, mAllElements, intersect);
 
 		timerCollision = timer::now().time_since_epoch() - timerUpdate - timerStart;
 
-		for (auto p : mPlayer)
-			p.second->update(timediff);
+		{
+			lock_guard<mutex> _lock(mMutexPlayer);
+			for (auto& p : mPlayer)
+				p.second->update(timediff);
+		}
 
 		mFoodSpawnTimer += timediff;
 		if (mFoodSpawnTimer > 1 / mOptions.food.spawn) {
@@ -221,13 +303,13 @@ void Gamefield::update(double timediff) {
 			mItemSpawnTimer = 0;
 		}
 
-		vector<ElementPtr> tmpNew;
+		vector<Element*> tmpNew;
 		{
 			lock_guard<mutex> _lock(mMutexNewElements);
 			tmpNew = std::move(mNewElements);
 			mNewElements.clear();
 		}
-		vector<ElementPtr> tmpDeleted;
+		vector<Element*> tmpDeleted;
 		{
 			lock_guard<mutex> _lock(mMutexDeletedElements);
 			tmpDeleted = std::move(mDeletedElements);
@@ -237,7 +319,12 @@ void Gamefield::update(double timediff) {
 		//Send updated data
 		mElementUpdateTimer += timediff;
 		if (mElementUpdateTimer > 1) {
-			sendToAll(make_shared<SetElementsPacket>(mElements));
+			PacketPtr packet;
+			{
+				lock_guard<mutex> _lock(mMutexElements);
+				packet = make_shared<SetElementsPacket>(mElements);
+			}
+			sendToAll(packet);
 			mElementUpdateTimer = 0;
 		}
 		else if (tmpNew.size() + tmpDeleted.size() + changed.size() > 0) {
@@ -245,7 +332,7 @@ void Gamefield::update(double timediff) {
 			//printf("Sending Update %ld\n", mElements.size());
 		}
 
-		for (ElementPtr& elem : tmpDeleted)
+		for (Element* elem : tmpDeleted)
 			_destroyElement(elem);
 	}
 
@@ -254,17 +341,48 @@ void Gamefield::update(double timediff) {
 	mFPSControl.timerUpdate.push_back(timerUpdate);
 	mFPSControl.timerCollision.push_back(timerCollision);
 	mFPSControl.timerOther.push_back(timerOther);
+	mFPSControl.pairTests.push_back(mBroadphase->collectPairTests() + (mStaticIndex ? mStaticIndex->collectPairTests() : 0) +
+									(mSweepIndex ? mSweepIndex->collectPairTests() : 0));
+	mFPSControl.relocations.push_back(mBroadphase->collectRelocations());
+	mBroadphase->collectPairTypes(mFPSControl.pairsReported, mFPSControl.pairsDropped);
+	if(mStaticIndex)
+		mStaticIndex->collectPairTypes(mFPSControl.pairsReported, mFPSControl.pairsDropped);
+	if(mSweepIndex)
+		mSweepIndex->collectPairTypes(mFPSControl.pairsReported, mFPSControl.pairsDropped);
 	if(mFPSControl.timerUpdate.size() > 60) {
 		mFPSControl.timerUpdate.pop_front();
 		mFPSControl.timerCollision.pop_front();
 		mFPSControl.timerOther.pop_front();
+		mFPSControl.pairTests.pop_front();
+		mFPSControl.relocations.pop_front();
 	}
 	//printf("End of Frame\n");
 }
 
+Broadphase* Gamefield::createBroadphase() {
+	Vector size(mOptions.width, mOptions.height);
+
+	if(mOptions.collision.broadphase == "spatialhash")
+		return new SpatialHash(size, getCellSize());
+	if(mOptions.collision.broadphase == "sweepandprune")
+		return new SweepAndPrune();
+	if(mOptions.collision.broadphase == "linearquadtree")
+		return new LinearQuadTree(size);
+	if(mOptions.collision.broadphase == "aabbtree")
+		return new AABBTree();
+	double looseness = 1;
+	if(mOptions.collision.broadphase == "loosequadtree")
+		looseness = max(mOptions.collision.looseness, 1.);
+	else if(mOptions.collision.broadphase != "quadtree")
+		fprintf(stderr, "Unknown broadphase %s, using quadtree\n", mOptions.collision.broadphase.c_str());
+	QuadTree* tree = new QuadTree(Vector(0,0), size, mOptions.collision.splitAmount, mOptions.collision.combineAmount, looseness);
+	tree->setRebuild(mOptions.collision.rebuild);
+	return tree;
+}
+
 struct CollisionStore {
-	ElementPtr e1;
-	ElementPtr e2;
+	ElementHandle e1;
+	ElementHandle e2;
 	//Distance of both elements is reduces in every frame by (e1.speed + e2.speed) * timediff
 	double distance;
 };
@@ -273,8 +391,8 @@ bool operator <(const CollisionStore& a, const CollisionStore& b) {
 	return a.distance < b.distance;
 }
 
-uint64_t hash(uint32_t a, uint32_t b) {
-	return a < b ? a << 16 | b : b << 16 | a;
+uint64_t hash(ElementHandle a, ElementHandle b) {
+	return a.getValue() < b.getValue() ? (uint64_t) a.getValue() << 32 | b.getValue() : (uint64_t) b.getValue() << 32 | a.getValue();
 }
 
 
@@ -284,37 +402,43 @@ void Gamefield::checkCollisions(double timediff) {
 	unordered_map<uint64_t, CollisionStore> elements;
 
 	//Update Objects in collision map
-	for(auto&& it : elements)
-		it.second.distance -= (it.second.e1->getSpeed() + it.second.e2->getSpeed())*(it.second.e1->getSpeed() + it.second.e2->getSpeed()) * timediff;
+	//Entries of destroyed elements are skipped and removed, their handles do not resolve any more
+	for(auto it = elements.begin(); it != elements.end();) {
+		Element* e1 = getElement(it->second.e1);
+		Element* e2 = getElement(it->second.e2);
+		if(!e1 || !e2) {
+			it = elements.erase(it);
+			continue;
+		}
+		it->second.distance -= (e1->getSpeed() + e2->getSpeed())*(e1->getSpeed() + e2->getSpeed()) * timediff;
+		it++;
+	}
 
 	//Insert new Objects into Collision Map
-	for(ElementPtr e1 : mNewElements)
-		for(ElementPtr e2 : mElements)
-			if(e1->getId() != e2->getId())
-				elements.emplace(hash(e1->getId(), e2->getId()), {e1, e2,
+	for(Element* e1 : mNewElements)
+		for(const ElementPtr& e2 : mElements)
+			if(e1 != e2.get())
+				elements.emplace(hash(e1->getHandle(), e2->getHandle()), {e1->getHandle(), e2->getHandle(),
 					e1->getPosition().distanceSquared(e2->getPosition())
 				});
 
 	//Check for collisions
 	for(auto&& it : elements) {
-		if(it.second.e1->isDeleted() || it.second.e2->isDeleted())
+		Element* e1 = getElement(it.second.e1);
+		Element* e2 = getElement(it.second.e2);
+		if(!e1 || !e2 || e1->isDeleted() || e2->isDeleted())
 			continue;
-		if(	it.second.distance <= it.second.e1->getSize()*it.second.e1->getSize() ||
-			it.second.distance <= it.second.e2->getSize()*it.second.e2->getSize())
+		if(	it.second.distance <= e1->getSize()*e1->getSize() ||
+			it.second.distance <= e2->getSize()*e2->getSize())
 		{
-			it.second.distance = it.second.e1->getPosition().distanceSquared(it.second.e2->getPosition());
-			if(it.second.distance <= it.second.e1->getSize()*it.second.e1->getSize() ||
-			   it.second.distance <= it.second.e2->getSize()*it.second.e2->getSize())
+			it.second.distance = e1->getPosition().distanceSquared(e2->getPosition());
+			if(it.second.distance <= e1->getSize()*e1->getSize() ||
+			   it.second.distance <= e2->getSize()*e2->getSize())
 			{ // Now they actually intersect
-				doIntersect(it.second.e1, it.second.e2);
+				doIntersect(e1, e2);
 			}
 		}
 	}
-
-	//Remove deleted Objects from Collision map
-	for(ElementPtr e1 : mDeletedElements)
-		for(ElementPtr e2 : mElements)
-			elements.erase(hash(e1->getId(), e2->getId()));
 */
 	//Check collisions
 	for (size_t i = 0; i < mElements.size(); i++) {
@@ -324,7 +448,7 @@ void Gamefield::checkCollisions(double timediff) {
 		//Start at i + 1 because we already checked elements before
 		for (size_t j = 0; j < mElements.size(); j++) {
 			Element* e2 = mElements[j].get();
-			if (e1->getId() == e2->getId() || e2->isDeleted())
+			if (e1 == e2 || e2->isDeleted())
 				continue;
 			if (e1->intersect(e2)) {
 				doIntersect(e1, e2);
@@ -334,30 +458,51 @@ void Gamefield::checkCollisions(double timediff) {
 }
 
 
-void Gamefield::doIntersect(QuadTreeNodePtr ne1, QuadTreeNodePtr ne2) {
-	try {
-		ElementPtr e1(std::dynamic_pointer_cast<Element>(ne1->shared_from_this()));
-		ElementPtr e2(std::dynamic_pointer_cast<Element>(ne2->shared_from_this()));
-		if (e1->tryEat(e2)) {
+namespace {
+	typedef bool (*EatHandler)(Element& eater, Element& other);
 
-		} else if (e2->tryEat(e1)) {
+	template<class Eater, class Other>
+	bool eat(Element& eater, Element& other) { return static_cast<Eater&>(eater).tryEat(static_cast<Other&>(other)); }
 
-		}
-	} catch (std::bad_weak_ptr& e) {
-		printf("Bad Week Ptr %p or %p\n", ne1, ne2);
-		assert(false);
+	//[eater type][other type], NULL if the eater can not eat that type
+	constexpr EatHandler EAT_TABLE[ET_Item + 1][ET_Item + 1] = {
+		/* ET_Ball      */ { eat<Ball, Ball>, eat<Ball, Food>, eat<Ball, Shoot>, eat<Ball, Obstracle>, eat<Ball, Item> },
+		/* ET_Food      */ { NULL, NULL, NULL, NULL, NULL },
+		/* ET_Shoot     */ { NULL, NULL, NULL, NULL, NULL },
+		/* ET_Obstracle */ { eat<Obstracle, Ball>, NULL, eat<Obstracle, Shoot>, NULL, NULL },
+		/* ET_Item      */ { eat<Item, Ball>, NULL, NULL, NULL, NULL }
+	};
+
+	//Pairs the broadphases drop must not have a handler
+	constexpr bool isEatTableValid(int a = 0, int b = 0) {
+		return a > ET_Item ? true :
+			   b > ET_Item ? isEatTableValid(a + 1, 0) :
+			   (EAT_TABLE[a][b] == NULL || canInteract((ElementType) a, (ElementType) b)) && isEatTableValid(a, b + 1);
 	}
+	static_assert(isEatTableValid(), "Eat handler for element types that can not interact");
+}
+
+void Gamefield::doIntersect(QuadTreeNodePtr ne1, QuadTreeNodePtr ne2) {
+	//Only Elements are added to the broadphases and their collision type is the ElementType
+	Element& e1 = static_cast<Element&>(*ne1);
+	Element& e2 = static_cast<Element&>(*ne2);
+	EatHandler eat1 = EAT_TABLE[e1.getCollisionType()][e2.getCollisionType()];
+	EatHandler eat2 = EAT_TABLE[e2.getCollisionType()][e1.getCollisionType()];
+	if (eat1 && eat1(e1, e2))
+		return;
+	if (eat2)
+		eat2(e2, e1);
 }
 
 ElementPtr Gamefield::createFood() {
-	ElementPtr f = std::make_shared<Food>(shared_from_this(), mElementIds++, generatePos());
+	ElementPtr f = allocateElement<Food>(ET_Food, generatePos(), mFoodColor);
 	addElement(f);
 	mFoodCounter++;
 	return f;
 }
 
 ElementPtr Gamefield::createItem() {
-	ElementPtr o = std::make_shared<Item>(shared_from_this(), mElementIds++, generatePos());
+	ElementPtr o = allocateElement<Item>(ET_Item, generatePos(), mItemColor);
 	addElement(o);
 	mItemCounter++;
 	return o;
@@ -366,20 +511,33 @@ ElementPtr Gamefield::createItem() {
 void Gamefield::addElement(ElementPtr const& elem) {
 	{
 		lock_guard<mutex> _lock(mMutexElements);
-		mQuadTree->add(elem.get());
+		elem->setCollisionType(elem->getType(), getInteractionMask(elem->getType()));
+		if (mStaticIndex && !elem->isMoveable())
+			mStaticIndex->add(elem.get());
+		else
+			mBroadphase->add(elem.get());
+		mElementTable.set(elem->getHandle(), elem.get());
+		//Only complete elements that are in a broadphase are moved, the store finds them by the handle
+		if (elem->isMoveable())
+			static_cast<MoveableElement*>(elem.get())->addToStore();
+		elem->mIndex = (uint32_t) mElements.size();
 		mElements.push_back(elem);
 	}
 	{
 		lock_guard<mutex> _lock(mMutexNewElements);
-		mNewElements.push_back(elem);
+		mNewElements.push_back(elem.get());
 	}
 }
 
 void Gamefield::onDisconnected(ClientPtr client) {
+	lock_guard<mutex> _lock(mMutexPlayer);
 	auto it = mPlayer.find(client->getId());
 	if(it != mPlayer.end()) {
-		for(BallPtr ball : it->second->getBalls())
-			destroyElement(ball);
+		//Copied, destroying a Ball removes it from the Player
+		vector<ElementHandle> balls = it->second->getBalls();
+		for(ElementHandle handle : balls)
+			if(BallPtr ball = lockElement<Ball>(handle))
+				destroyElement(*ball);
 		mPlayer.erase(it);
 	}
 	mClients.remove(client);
@@ -395,9 +553,15 @@ void Gamefield::onJoin(ClientPtr client, PacketPtr packet) {
 	client->on(PID_GetStats, std::bind(&Gamefield::onGetStats, this, _1, _2));
 	client->setOnDisconnect(std::bind(&Gamefield::onDisconnected, this, _1));
 	//Send all elements
-	client->emit(std::make_shared<SetElementsPacket>(mElements));
+	{
+		lock_guard<mutex> _lock(mMutexElements);
+		client->emit(std::make_shared<SetElementsPacket>(mElements));
+	}
 	//Add to update queue
-	mClients.push_back(client);
+	{
+		lock_guard<mutex> _lock(mMutexPlayer);
+		mClients.push_back(client);
+	}
 
 	if(mUpdaterRunning == false)
 		startUpdater();
@@ -405,6 +569,7 @@ void Gamefield::onJoin(ClientPtr client, PacketPtr packet) {
 
 void Gamefield::onLeave(ClientPtr client, PacketPtr packet) {
 	//Remove from update queue
+	lock_guard<mutex> _lock(mMutexPlayer);
 	mClients.remove(client);
 
 	if(mClients.empty())
@@ -413,11 +578,12 @@ void Gamefield::onLeave(ClientPtr client, PacketPtr packet) {
 
 void Gamefield::onStart(ClientPtr client, PacketPtr packet) {
 	auto p = std::dynamic_pointer_cast<StartPacket >(packet);
-	String color = mOptions.player.color[rand()%mOptions.player.color.size()];
+	uint16_t color = mPlayerColors[rand()%mPlayerColors.size()];
 	printf("Player %s joind the game\n", p->Name.c_str());
 	PlayerPtr ply = std::make_shared<Player>(shared_from_this(), client, color, p->Name);
+	lock_guard<mutex> _lock(mMutexPlayer);
 	mPlayer[client->getId()] = ply;
-	ply->addBall(createBall(ply));
+	ply->addBall(createBall(ply)->getHandle());
 	ply->updateClient();
 	client->emit(std::make_shared<EmptyPacket<PID_Start> >());
 }
@@ -426,14 +592,41 @@ void Gamefield::onGetStats(ClientPtr client, PacketPtr packet) {
 	double timerUpdate = 0;
 	double timerCollision = 0;
 	double timerOther = 0;
+	double pairTests = 0;
+	double relocations = 0;
+	//Slowest check, the rebuild mode should mostly lower this one
+	double timerCollisionMax = 0;
 	for(auto it : mFPSControl.timerUpdate)
 		timerUpdate += std::chrono::duration_cast<std::chrono::duration<double, std::milli> >(it).count() / mFPSControl.timerUpdate.size();
-	for(auto it : mFPSControl.timerCollision)
-		timerCollision += std::chrono::duration_cast<std::chrono::duration<double, std::milli> >(it).count() / mFPSControl.timerCollision.size();
+	for(auto it : mFPSControl.timerCollision) {
+		double ms = std::chrono::duration_cast<std::chrono::duration<double, std::milli> >(it).count();
+		timerCollision += ms / mFPSControl.timerCollision.size();
+		timerCollisionMax = max(timerCollisionMax, ms);
+	}
 	for(auto it : mFPSControl.timerOther)
 		timerOther += std::chrono::duration_cast<std::chrono::duration<double, std::milli> >(it).count() / mFPSControl.timerOther.size();
-
-	printf("Timings: Update: %lf Collision: %lf Other: %lf Elements: %ld QuadTreeNodes: %ld\n", timerUpdate, timerCollision, timerOther, mElements.size(), mQuadTree->getChildCount());
+	for(auto it : mFPSControl.pairTests)
+		pairTests += (double)it / mFPSControl.pairTests.size();
+	for(auto it : mFPSControl.relocations)
+		relocations += (double)it / mFPSControl.relocations.size();
+
+	printf("Timings: Update: %lf Collision: %lf (max %lf) Other: %lf Elements: %ld Broadphase: %s Nodes: %ld Static: %ld Swept: %ld PairTests: %.0lf Relocations: %.1lf\n", timerUpdate, timerCollision, timerCollisionMax, timerOther, mElements.size(), mBroadphase->getName(), mBroadphase->getChildCount(), mStaticIndex ? mStaticIndex->getElementCount() : 0, mSweepIndex ? mSweepIndex->getElementCount() : 0, pairTests, relocations);
+	static const char* typeNames[] = { "Ball", "Food", "Shoot", "Obstracle", "Item" };
+	for(int i = 0; i <= ET_Item; i++) {
+		for(int j = i; j <= ET_Item; j++) {
+			uint64_t reported = mFPSControl.pairsReported[i][j], dropped = mFPSControl.pairsDropped[i][j];
+			if(reported + dropped > 0)
+				printf("  %s/%s: Reported: %lu Dropped: %lu\n", typeNames[i], typeNames[j], reported, dropped);
+		}
+	}
+	for(int i = 0; i <= ET_Item; i++) {
+		uint64_t hits = 0, misses = 0;
+		mPools[i]->collectStats(hits, misses);
+		if(hits + misses > 0)
+			printf("  Pool %s: Hits: %lu Misses: %lu Free: %ld\n", typeNames[i], hits, misses, mPools[i]->getFreeCount());
+	}
+	memset(mFPSControl.pairsReported, 0, sizeof(mFPSControl.pairsReported));
+	memset(mFPSControl.pairsDropped, 0, sizeof(mFPSControl.pairsDropped));
 	if(client)
 		client->emit(std::make_shared<StatsPacket>(timerUpdate, timerCollision, timerOther, (uint32_t)mElements.size(), (uint32_t)mPlayer.size()));
 }
@@ -10,11 +10,19 @@
 #include "Vector.h"
 #include "Json/JSONValue.h"
 #include "Obstracle.h"
+#include "Broadphase.h"
+#include "StaticIndex.h"
+#include "SweepIndex.h"
+#include "ElementStore.h"
+#include "ElementPool.h"
+#include "ElementHandle.h"
+#include "Palette.h"
 
 
 struct Options {
 	double width = 5000;
 	double height = 5000;
+	double tickRate = 30; // updates per sec
 	struct Food {
 		String color = "#F1C40F";
 		double spawn = 5; // per Sec
@@ -55,19 +63,36 @@ struct Options {
 		double spawn = 0.1;
 		uint32_t max = 5;
 	} item;
+	struct Collision {
+		String broadphase = "quadtree"; // quadtree, loosequadtree, linearquadtree, spatialhash, sweepandprune, aabbtree
+		double cellSize = 0; // spatialhash and static index, 0 = 4 * player.defaultSize
+		double looseness = 3; // loosequadtree nodes keep elements up to (looseness - 1) / 2 of their size
+		uint32_t splitAmount = 5; // quadtree leafs with more elements are split
+		uint32_t combineAmount = 2; // quadtree subtrees with at most this many elements are combined
+		bool rebuild = false; // quadtree and loosequadtree are built from all elements every tick instead of being updated
+		uint32_t threads = 1; // threads for the collision detection, 0 = one per core (the worker pool is shared by all lobbies)
+		bool staticIndex = false; // keep Food and Items in their own grid that is only tested against moving elements
+		bool continuous = false; // also test elements along their way if they move further than their size in one tick
+	} collision;
 };
 DECLARE_JSON_STRUCT(Options::Food, color, spawn, max, mass, size)
 DECLARE_JSON_STRUCT(Options::Player, defaultSize, startMass, color, targetForce, acceleration, maxSpeed, speedPenalty, eatFactor, minSplitMass, starveOffset, starveMassFactor)
 DECLARE_JSON_STRUCT(Options::Shoot, mass, size, speed, acceleration)
 DECLARE_JSON_STRUCT(Options::Obstracle, color, spawn, max, size, needMass, eatCount)
 DECLARE_JSON_STRUCT(Options::Item, color, size, spawn, max)
-DECLARE_JSON_STRUCT(Options, width, height, food, player, shoot, obstracle, item)
+DECLARE_JSON_STRUCT(Options::Collision, broadphase, cellSize, looseness, splitAmount, combineAmount, rebuild, threads, staticIndex, continuous)
+DECLARE_JSON_STRUCT(Options, width, height, tickRate, food, player, shoot, obstracle, item, collision)
 
 
 struct FPSControl {
 	list<std::chrono::high_resolution_clock::duration> timerUpdate;
 	list<std::chrono::high_resolution_clock::duration> timerCollision;
 	list<std::chrono::high_resolution_clock::duration> timerOther;
+	list<uint64_t> pairTests;
+	list<uint64_t> relocations;
+	//Since the last stats output
+	PairTypeCounters pairsReported = {};
+	PairTypeCounters pairsDropped = {};
 };
 
 class Gamefield : public std::enable_shared_from_this<Gamefield> {
@@ -75,15 +100,36 @@ private:
 	ServerPtr mServer;
 	String mName;
 	Options mOptions;
+	//Declared before the elements, so they are destroyed after the last element that uses them
+	//Movement state of all MoveableElements
+	ElementStore mElementStore;
+	//Memory of the elements by type, reused after they are destroyed
+	ElementPoolPtr mPools[ET_Item + 1];
+	//Handle of every element, also the ids sent to the clients
+	ElementTable mElementTable;
+	//Colors of the options, the elements and players only keep the index
+	Palette mColors;
+	//The colors of the options, interned once
+	uint16_t mFoodColor;
+	uint16_t mObstracleColor;
+	uint16_t mItemColor;
+	vector<uint16_t> mPlayerColors;
+	//Owns the elements, everything else only borrows them until they are removed in _destroyElement
 	vector<ElementPtr> mElements;
-	volatile uint32_t mElementIds = 0;
 	unordered_map<uint64_t, PlayerPtr> mPlayer;
 	list<ClientPtr> mClients;
 
-	vector<ElementPtr> mNewElements;
-	vector<ElementPtr> mDeletedElements;
+	vector<Element*> mNewElements;
+	vector<Element*> mDeletedElements;
 
-	QuadTreePtr mQuadTree;
+	unique_ptr<Broadphase> mBroadphase;
+	unique_ptr<StaticIndex> mStaticIndex;
+	vector<QuadTreeNodePtr> mMovingElements;
+	unique_ptr<SweepIndex> mSweepIndex;
+	vector<QuadTreeNodePtr> mSweptElements;
+	vector<QuadTreeNodePtr> mAllElements;
+	//Nearest elements of the static index, merged by nearestK
+	vector<Broadphase::Nearest> mNearest;
 
 	double mFoodSpawnTimer = 0;
 	volatile uint32_t mFoodCounter = 0;
@@ -98,6 +144,8 @@ private:
 
 	FPSControl mFPSControl;
 	mutex mMutexElements;
+	//Players and clients are changed by the network threads
+	mutex mMutexPlayer;
 	mutex mMutexNewElements;
 	mutex mMutexDeletedElements;
 
@@ -107,18 +155,32 @@ public:
 
 	const String& getName() const { return mName; }
 	inline const Options& getOptions() const { return mOptions; }
+	ElementStore& getElementStore() { return mElementStore; }
+	Palette& getColors() { return mColors; }
 	uint32_t getPlayerCount() const { return mPlayer.size(); }
 
+	//NULL if the element was destroyed, the handle has to belong to an element of type T
+	template<typename T = Element>
+	T* getElement(ElementHandle handle) { return static_cast<T*>(mElementTable.get(handle)); }
+	//Owning pointer for the network threads, the simulation may destroy the element meanwhile
+	template<typename T = Element>
+	shared_ptr<T> lockElement(ElementHandle handle) { return std::static_pointer_cast<T>(mElementTable.lock(handle)); }
+
 	BallPtr createBall(PlayerPtr const&  player) { return createBall(player, generatePos()); }
 	BallPtr createBall(PlayerPtr const&  player, const Vector& position);
 
-	ShootPtr createShoot(const Vector& pos, const String& color, const Vector& direction);
+	ShootPtr createShoot(const Vector& pos, uint16_t color, const Vector& direction);
 
 	ObstraclePtr createObstracle() { return createObstracle(generatePos()); }
 	ObstraclePtr createObstracle(const Vector& position);
 
 
-	void destroyElement(ElementPtr const&  elem);
+	void destroyElement(Element& elem);
+
+	//Queries the broadphase and the static index, only from the simulation thread
+	void queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor);
+	void queryCircle(const Vector& center, double radius, uint32_t types, QueryVisitor visitor);
+	size_t nearestK(const Vector& position, size_t k, uint32_t types, Broadphase::Nearest* result);
 
 	void sendToAll(PacketPtr packet);
 
@@ -126,17 +188,26 @@ public:
 
 private:
 	Vector generatePos();
-	void _destroyElement(ElementPtr const&  elem);
+	void _destroyElement(Element* elem);
 
 	void startUpdater();
 	void updateLoop();
 
 	void update(double timediff);
 
+	Broadphase* createBroadphase();
+	double getCellSize() const { return mOptions.collision.cellSize > 0 ? mOptions.collision.cellSize : 4 * mOptions.player.defaultSize; }
+
 	void checkCollisions(double timediff);
 
 	void doIntersect(QuadTreeNodePtr e1, QuadTreeNodePtr e2);
 
+	//Creates an element with a new handle in the pool of its type
+	template<typename T, typename... Args>
+	shared_ptr<T> allocateElement(ElementType type, Args&&... args) {
+		return std::allocate_shared<T>(PoolAllocator<T>(mPools[type]), shared_from_this(), mElementTable.acquire(), std::forward<Args>(args)...);
+	}
+
 	ElementPtr createFood();
 	ElementPtr createItem();
 
@@ -66,6 +66,11 @@ typedef std::shared_ptr<Item> ItemPtr;
 class ItemEffect;
 typedef std::unique_ptr<ItemEffect> ItemEffectPtr;
 
+class ElementPool;
+typedef std::shared_ptr<ElementPool> ElementPoolPtr;
+
+class Broadphase;
+typedef Broadphase* BroadphasePtr;
 class QuadTree;
 //typedef std::shared_ptr<QuadTree> QuadTreePtr;
 typedef QuadTree* QuadTreePtr;
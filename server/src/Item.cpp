@@ -6,21 +6,17 @@
 #include "Gamefield.h"
 #include "Ball.h"
 
-Item::Item(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition) :
-	Element(mGamefield, mId, mPosition,  mGamefield->getOptions().item.color, mGamefield->getOptions().item.size)
+Item::Item(GamefieldPtr mGamefield, ElementHandle mHandle, const Vector& mPosition, uint16_t mColor) :
+	Element(mGamefield, mHandle, mPosition, mColor, mGamefield->getOptions().item.size)
 {
 	mItemType = (ItemType) (rand() % IT_COUNT);
 }
 
 
-bool Item::tryEat(ElementPtr other) {
-	if(other->getType() == ET_Ball) {
-		BallPtr ball(std::dynamic_pointer_cast<Ball>(other));
-		ball->applyEffect(ItemEffect::create(mItemType, ball));
-		mGamefield->destroyElement(std::dynamic_pointer_cast<Element>(shared_from_this()));
-		return true;
-	}
-	return false;
+bool Item::tryEat(Ball& ball) {
+	ball.applyEffect(ItemEffect::create(mItemType, ball));
+	mGamefield->destroyElement(*this);
+	return true;
 }
 
 ElementData Item::get() const {
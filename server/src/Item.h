@@ -14,11 +14,12 @@ private:
 	ItemType mItemType;
 
 public:
-	Item(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition);
+	Item(GamefieldPtr mGamefield, ElementHandle mHandle, const Vector& mPosition, uint16_t mColor);
 	virtual ~Item() {}
 
 	virtual ElementType getType() const { return ET_Item; }
-	virtual bool tryEat(ElementPtr other);
+	//Applies the effect to the Ball
+	bool tryEat(Ball& ball);
 
 
 	virtual ElementData get() const;
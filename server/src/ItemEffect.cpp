@@ -4,6 +4,7 @@
 
 #include "ItemEffect.h"
 #include "Ball.h"
+#include "Gamefield.h"
 
 
 
@@ -17,7 +18,14 @@ void ItemEffect::registerEffect(uint8_t type, ItemEffect::Factory* factory) {
 	Creator::get().Effects[type].reset(factory);
 }
 
-ItemEffectPtr ItemEffect::create(uint8_t type, BallPtr const& ball) {
+ItemEffect::ItemEffect(Ball& ball) : mGamefield(ball.getGamefield()), mBall(ball.getHandle()) {
+}
+
+Ball* ItemEffect::getBall() const {
+	return mGamefield.getElement<Ball>(mBall);
+}
+
+ItemEffectPtr ItemEffect::create(uint8_t type, Ball& ball) {
 	assert(Creator::get().Effects.find(type) != Creator::get().Effects.end());
 	return std::move(ItemEffectPtr(Creator::get().Effects[type]->create(ball)));
 }
@@ -25,7 +33,7 @@ ItemEffectPtr ItemEffect::create(uint8_t type, BallPtr const& ball) {
 
 class HighGravityEffect : public ItemEffect {
 public:
-	HighGravityEffect(const BallPtr& ball) : ItemEffect(ball) { }
+	HighGravityEffect(Ball& ball) : ItemEffect(ball) { }
 
 	ItemType getType() const { return IT_HighGravity; }
 };
@@ -36,7 +44,7 @@ class SniperShootEffect : public ItemEffect {
 private:
 	uint8_t mCount = 3;
 public:
-	SniperShootEffect(const BallPtr& ball) : ItemEffect(ball) { }
+	SniperShootEffect(Ball& ball) : ItemEffect(ball) { }
 
 	virtual bool update(double timediff) {
 		return true;
@@ -56,14 +64,15 @@ class BoosterEffect : public ItemEffect {
 private:
 	double mTimediff = 0;
 public:
-	BoosterEffect(const BallPtr& ball) : ItemEffect(ball) {
-		mBall->setBoostFactor(3);
+	BoosterEffect(Ball& ball) : ItemEffect(ball) {
+		ball.setBoostFactor(3);
 	}
 
 	bool update(double diff) {
 		mTimediff+=diff;
 		if(mTimediff > 5) {
-			mBall->setBoostFactor(1);
+			if(Ball* ball = getBall())
+				ball->setBoostFactor(1);
 			return false;
 		}
 		return true;
@@ -78,7 +87,7 @@ class InvincibleEffect : public ItemEffect {
 private:
 	double mTimediff = 0;
 public:
-	InvincibleEffect(const BallPtr& ball) : ItemEffect(ball) { }
+	InvincibleEffect(Ball& ball) : ItemEffect(ball) { }
 
 	bool update(double diff) {
 		mTimediff+=diff;
@@ -94,7 +103,7 @@ class NoHungerEffect : public ItemEffect {
 private:
 	double mTimediff = 0;
 public:
-	NoHungerEffect(const BallPtr& ball) : ItemEffect(ball) { }
+	NoHungerEffect(Ball& ball) : ItemEffect(ball) { }
 
 	bool update(double diff) {
 		mTimediff+=diff;
@@ -110,7 +119,7 @@ class LowerCooldownEffect : public ItemEffect {
 private:
 	double mTimediff = 0;
 public:
-	LowerCooldownEffect(const BallPtr& ball) : ItemEffect(ball) { }
+	LowerCooldownEffect(Ball& ball) : ItemEffect(ball) { }
 
 	bool update(double diff) {
 		mTimediff+=diff;
@@ -124,14 +133,14 @@ RegisterItemEffect(IT_LowerCooldown, LowerCooldownEffect)
 
 class FakeEffect : public ItemEffect {
 public:
-	FakeEffect(const BallPtr& ball) : ItemEffect(ball) {
-		int32_t mass = ball->getMass();
+	FakeEffect(Ball& ball) : ItemEffect(ball) {
+		int32_t mass = ball.getMass();
 		int splitcount = 5;
 		if (mass < 100)
 			splitcount = mass / 20;
 		int32_t newmass = mass / splitcount;
 		for (double angle = 0; angle < 2 * M_PI; angle += (2 * M_PI) / splitcount) {
-			BallPtr b = ball->splitUp(Vector::FromAngle(angle));
+			BallPtr b = ball.splitUp(Vector::FromAngle(angle));
 			b->setMass(newmass);
 		}
 	}
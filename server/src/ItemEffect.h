@@ -6,6 +6,7 @@
 #define SERVER_ITEMEFFEKT_H
 
 #include "GlobalDefs.h"
+#include "ElementHandle.h"
 
 enum ItemType : uint8_t {
 	IT_HighGravity, 	//Other Balls around get attracted
@@ -32,11 +33,11 @@ private:
 	class Factory {
 	public:
 		virtual ~Factory() {}
-		virtual ItemEffect* create(BallPtr const& ball) = 0;
+		virtual ItemEffect* create(Ball& ball) = 0;
 	};
 	template<class T>
 	class FactoryImpl : public Factory {
-		ItemEffect* create(BallPtr const& ball) {
+		ItemEffect* create(Ball& ball) {
 			return new T(ball);
 		}
 	};
@@ -47,9 +48,15 @@ private:
 	};
 
 protected:
-	BallPtr mBall;
+	Gamefield& mGamefield;
+	//The effect is kept by the Ball, so it only has the handle and does not keep the Ball alive
+	ElementHandle mBall;
+
+	//NULL if the Ball was destroyed
+	Ball* getBall() const;
 public:
-	ItemEffect(BallPtr const& ball) : mBall(ball) { }
+	ItemEffect(Ball& ball);
+	virtual ~ItemEffect() {}
 
 	//Returns false if the effect is over
 	virtual bool update(double timediff) { return false; }
@@ -59,7 +66,7 @@ public:
 	virtual ItemType getType() const = 0;
 
 	static void registerEffect(uint8_t type, Factory* factory);
-	static ItemEffectPtr create(uint8_t type, BallPtr const& ball);
+	static ItemEffectPtr create(uint8_t type, Ball& ball);
 };
 #define RegisterItemEffect(id, ...) namespace { ItemEffect::Register<__VA_ARGS__> __itemEffect_##id(id); }
 
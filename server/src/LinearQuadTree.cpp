@@ -0,0 +1,263 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "LinearQuadTree.h"
+#include "QuadTree.h"
+#include "PackedIntersect.h"
+
+static const uint32_t NO_INDEX = (uint32_t) -1;
+
+LinearQuadTree::LinearQuadTree(const Vector& mSize) :
+		mSize(mSize)
+{
+	mScale = Vector((1 << LEVELS) / max(mSize.x, 1.), (1 << LEVELS) / max(mSize.y, 1.));
+}
+
+void LinearQuadTree::findCollisions() {
+	{
+		lock_guard<mutex> _lock(mMutex);
+		compact();
+		size_t added = insertNew();
+		updateCodes();
+		//Insertion sort is slow for a lot of new unsorted elements (e.g. the initial food)
+		if(added * 16 > mEntries.size())
+			std::sort(mEntries.begin(), mEntries.end());
+		else
+			sort();
+		pack();
+	}
+
+	//Neighbouring elements are queried by the same task, so the ranges they test are mostly cached
+	runTasks((mElements.size() + TASK_SIZE - 1) / TASK_SIZE, [this] (size_t task, TaskResult& result) {
+		size_t end = min(mElements.size(), (task + 1) * TASK_SIZE);
+		for(size_t i = task * TASK_SIZE; i < end; i++)
+			query(i, result);
+	});
+}
+
+void LinearQuadTree::query(size_t index, TaskResult& result) {
+	QuadTreeNodePtr elem = mElements[index];
+	if(elem->isDeleted() || !(elem->getCollisionMask() & mTypes))
+		return;
+	//Only the centers inside the own circle, the other elements find this one
+	double x = mXs[index], y = mYs[index], size = mSizes[index];
+	uint32_t minX = toGrid(x - size, mScale.x), minY = toGrid(y - size, mScale.y);
+	uint32_t maxX = toGrid(x + size, mScale.x), maxY = toGrid(y + size, mScale.y);
+
+	//Start at the smallest node containing the whole circle instead of the root
+	uint32_t level = 0;
+	while(level < LEVELS && ((minX ^ maxX) | (minY ^ maxY)) >> (LEVELS - level - 1) == 0)
+		level++;
+	uint32_t shift = LEVELS - level;
+	uint32_t nodeX = minX >> shift, nodeY = minY >> shift;
+	uint64_t start = spreadBits(nodeX << shift) | ((uint64_t) spreadBits(nodeY << shift) << 1);
+	uint64_t codes = (uint64_t) 1 << (2 * shift);
+	auto begin = std::lower_bound(mCodes.begin(), mCodes.end(), (uint32_t) start);
+	auto end = start + codes > NO_INDEX ? mCodes.end() : std::lower_bound(begin, mCodes.end(), (uint32_t) (start + codes));
+	queryNode(index, level, nodeX, nodeY, begin - mCodes.begin(), end - mCodes.begin(), minX, minY, maxX, maxY, result);
+}
+
+void LinearQuadTree::queryNode(size_t index, uint32_t level, uint32_t x, uint32_t y, size_t begin, size_t end,
+		uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, TaskResult& result) {
+	if(begin == end)
+		return;
+	//Grid cells covered by the node
+	uint32_t span = 1u << (LEVELS - level);
+	uint32_t fromX = x * span, fromY = y * span;
+	uint32_t toX = fromX + span - 1, toY = fromY + span - 1;
+	if(toX < minX || fromX > maxX || toY < minY || fromY > maxY)
+		return;
+	bool inside = fromX >= minX && toX <= maxX && fromY >= minY && toY <= maxY;
+	if(inside || end - begin <= LEAF_SIZE || level == LEVELS) {
+		testRange(index, begin, end, result);
+		return;
+	}
+
+	size_t bounds[5];
+	splitRange(fromX, fromY, span, begin, end, bounds);
+	for(uint32_t c = 0; c < 4; c++)
+		queryNode(index, level + 1, x * 2 + (c & 1), y * 2 + (c >> 1), bounds[c], bounds[c + 1], minX, minY, maxX, maxY, result);
+}
+
+void LinearQuadTree::splitRange(uint32_t fromX, uint32_t fromY, uint32_t span, size_t begin, size_t end, size_t* bounds) const {
+	//The children are the four quarters of the range, in the order of the Morton code
+	uint64_t start = spreadBits(fromX) | ((uint64_t) spreadBits(fromY) << 1);
+	uint64_t childCodes = (uint64_t) span * span / 4;
+	bounds[0] = begin;
+	bounds[4] = end;
+	for(uint32_t c = 1; c < 4; c++)
+		bounds[c] = std::lower_bound(mCodes.begin() + bounds[c - 1], mCodes.begin() + end, (uint32_t) (start + c * childCodes)) - mCodes.begin();
+}
+
+void LinearQuadTree::testRange(size_t index, size_t begin, size_t end, TaskResult& result) {
+	QuadTreeNodePtr elem = mElements[index];
+	double x = mXs[index], y = mYs[index], size = mSizes[index];
+	for(size_t i = begin; i < end; i += PACKED_BATCH) {
+		size_t count = min(end - i, (size_t) PACKED_BATCH);
+		uint64_t hits = intersectPacked(x, y, size, &mXs[i], &mYs[i], &mSizes[i], count);
+		result.pairTests += count;
+		for(; hits; hits &= hits - 1) {
+			size_t other = i + __builtin_ctzll(hits);
+			if(other == index) continue;
+			double dx = mXs[other] - x, dy = mYs[other] - y;
+			double dist = dx * dx + dy * dy;
+			//Center of other outside of elem, reported by the query of other
+			if(dist > size * size) continue;
+			//Both centers inside the other circle, only the first element reports the pair
+			if(dist <= mSizes[other] * mSizes[other] && other < index) continue;
+			QuadTreeNodePtr e2 = mElements[other];
+			if(e2->isDeleted()) continue;
+			if(!elem->canCollide(e2)) {
+				result.drop(elem->getCollisionType(), e2->getCollisionType());
+				continue;
+			}
+			result.pairs.push_back(CollisionPair {elem, e2});
+		}
+	}
+}
+
+bool LinearQuadTree::add(QuadTreeNodePtr elem) {
+	lock_guard<mutex> _lock(mMutex);
+	elem->mBroadphase = this;
+	elem->mProxy = NO_INDEX;
+	mNewElements.push_back(elem);
+	return true;
+}
+
+bool LinearQuadTree::remove(QuadTreeNodePtr elem) {
+	lock_guard<mutex> _lock(mMutex);
+	if(elem->mBroadphase != this)
+		return false;
+	elem->mBroadphase = NULL;
+	if(elem->mProxy == NO_INDEX) { //Still queued
+		auto it = std::find(mNewElements.begin(), mNewElements.end(), elem);
+		if(it == mNewElements.end())
+			return false;
+		*it = mNewElements.back();
+		mNewElements.pop_back();
+		return true;
+	}
+	if(elem->mProxy >= mEntries.size() || mEntries[elem->mProxy].elem != elem)
+		return false;
+	//Dropped on the next check, the order of the others stays the same
+	mEntries[elem->mProxy].elem = NULL;
+	mRemovedCount++;
+	return true;
+}
+
+void LinearQuadTree::compact() {
+	if(mRemovedCount == 0)
+		return;
+
+	size_t end = 0;
+	for(size_t i = 0; i < mEntries.size(); i++) {
+		if(mEntries[i].elem)
+			mEntries[end++] = mEntries[i];
+	}
+	mEntries.resize(end);
+	mRemovedCount = 0;
+}
+
+size_t LinearQuadTree::insertNew() {
+	size_t added = mNewElements.size();
+	for(QuadTreeNodePtr elem : mNewElements)
+		mEntries.push_back(Entry {0, elem});
+	mNewElements.clear();
+	return added;
+}
+
+void LinearQuadTree::updateCodes() {
+	for(Entry& entry : mEntries) {
+		const Vector& pos = entry.elem->getPosition();
+		entry.code = spreadBits(toGrid(pos.x, mScale.x)) | (spreadBits(toGrid(pos.y, mScale.y)) << 1);
+	}
+}
+
+void LinearQuadTree::sort() {
+	for(size_t i = 1; i < mEntries.size(); i++) {
+		if(!(mEntries[i] < mEntries[i - 1]))
+			continue;
+		Entry entry = mEntries[i];
+		size_t j = i;
+		do {
+			mEntries[j] = mEntries[j - 1];
+			j--;
+		} while(j > 0 && entry < mEntries[j - 1]);
+		mEntries[j] = entry;
+	}
+}
+
+void LinearQuadTree::pack() {
+	size_t count = mEntries.size();
+	mCodes.resize(count);
+	mElements.resize(count);
+	mXs.resize(count);
+	mYs.resize(count);
+	mSizes.resize(count);
+	mTypes = 0;
+	mCellCount = 0;
+	for(size_t i = 0; i < count; i++) {
+		QuadTreeNodePtr elem = mEntries[i].elem;
+		if(i == 0 || mEntries[i].code != mEntries[i - 1].code)
+			mCellCount++;
+		elem->mProxy = (uint32_t) i;
+		mCodes[i] = mEntries[i].code;
+		mElements[i] = elem;
+		mXs[i] = elem->getPosition().x;
+		mYs[i] = elem->getPosition().y;
+		mSizes[i] = elem->getSize();
+		mTypes |= 1u << elem->getCollisionType();
+	}
+}
+
+uint32_t LinearQuadTree::toGrid(double pos, double scale) const {
+	if(pos <= 0)
+		return 0;
+	return min((uint32_t) min(pos * scale, (double) NO_INDEX), (1u << LEVELS) - 1);
+}
+
+uint32_t LinearQuadTree::spreadBits(uint32_t value) {
+	//Moves bit i to bit 2 * i
+	value &= 0xFFFF;
+	value = (value | (value << 8)) & 0x00FF00FF;
+	value = (value | (value << 4)) & 0x0F0F0F0F;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+void LinearQuadTree::queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor) {
+	//The entries are only changed by the simulation thread, added elements are queued
+	//and removed ones are NULL until the next check
+	if(!(types & mTypes) || from.x > to.x || from.y > to.y)
+		return;
+	size_t begin = mFound.size();
+	queryRect(0, 0, 0, 0, mCodes.size(), toGrid(from.x, mScale.x), toGrid(from.y, mScale.y), toGrid(to.x, mScale.x), toGrid(to.y, mScale.y),
+			from, to, types);
+	visitFound(begin, visitor);
+}
+
+void LinearQuadTree::queryRect(uint32_t level, uint32_t x, uint32_t y, size_t begin, size_t end,
+		uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, const Vector& from, const Vector& to, uint32_t types) {
+	if(begin == end)
+		return;
+	uint32_t span = 1u << (LEVELS - level);
+	uint32_t fromX = x * span, fromY = y * span;
+	uint32_t toX = fromX + span - 1, toY = fromY + span - 1;
+	if(toX < minX || fromX > maxX || toY < minY || fromY > maxY)
+		return;
+	if(end - begin <= LEAF_SIZE || level == LEVELS) {
+		for(size_t i = begin; i < end; i++) {
+			QuadTreeNodePtr elem = mEntries[i].elem;
+			if(elem && matches(elem, from, to, types))
+				mFound.push_back(elem);
+		}
+		return;
+	}
+
+	size_t bounds[5];
+	splitRange(fromX, fromY, span, begin, end, bounds);
+	for(uint32_t c = 0; c < 4; c++)
+		queryRect(level + 1, x * 2 + (c & 1), y * 2 + (c >> 1), bounds[c], bounds[c + 1], minX, minY, maxX, maxY, from, to, types);
+}
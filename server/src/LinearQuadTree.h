@@ -0,0 +1,96 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_LINEARQUADTREE_H
+#define SERVER_LINEARQUADTREE_H
+
+#include "GlobalDefs.h"
+#include "Vector.h"
+#include "Broadphase.h"
+
+/*
+ * Quadtree without node objects. All elements are sorted by the Morton code of their position
+ * in one array, so every node of a quadtree is a continuous range of that array and the
+ * elements of one region are next to each other in memory.
+ *
+ * The order is kept between the checks and insertion sorted again like in SweepAndPrune,
+ * unless many elements were added since the last check, then it is sorted with std::sort.
+ * Every element queries the nodes its own circle overlaps and tests their ranges packed,
+ * a pair is reported by the element whose circle contains the center of the other one.
+ */
+class LinearQuadTree : public Broadphase {
+private:
+	struct Entry {
+		uint32_t code;
+		QuadTreeNodePtr elem;
+
+		bool operator <(const Entry& other) const { return code < other.code; }
+	};
+	//Bits per axis of the Morton code, so the deepest nodes are 1/65536 of the gamefield
+	static const uint32_t LEVELS = 16;
+	//Ranges with at most this many elements are tested without splitting them further
+	static const size_t LEAF_SIZE = 16;
+	//Elements tested by one task
+	static const size_t TASK_SIZE = 256;
+
+	Vector mSize;
+	Vector mScale;
+
+	vector<Entry> mEntries;
+	vector<QuadTreeNodePtr> mNewElements;
+	size_t mRemovedCount = 0;
+
+	//Sorted copy of the entries, only used by the checks
+	vector<uint32_t> mCodes;
+	vector<QuadTreeNodePtr> mElements;
+	vector<double> mXs;
+	vector<double> mYs;
+	vector<double> mSizes;
+	//Collision types of all elements
+	uint32_t mTypes = 0;
+	//Distinct codes, the occupied cells of the deepest level
+	size_t mCellCount = 0;
+
+	mutex mMutex;
+
+public:
+	LinearQuadTree(const Vector& mSize);
+
+	virtual bool add(QuadTreeNodePtr elem);
+	virtual bool remove(QuadTreeNodePtr elem);
+	virtual void update(QuadTreeNodePtr elem) {} //Codes are updated on every check
+
+	virtual size_t getElementCount() const { return mEntries.size() - mRemovedCount + mNewElements.size(); }
+	virtual size_t getChildCount() const { return mCellCount; } //Nodes are implicit, so the occupied cells
+
+	virtual const char* getName() const { return "linearquadtree"; }
+
+	//Walks the nodes of the order of the last check
+	virtual void queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor);
+
+protected:
+	virtual void findCollisions();
+
+private:
+	void compact();
+	size_t insertNew();
+	void updateCodes();
+	void sort();
+	void pack();
+
+	void query(size_t index, TaskResult& result);
+	void queryNode(size_t index, uint32_t level, uint32_t x, uint32_t y, size_t begin, size_t end,
+			uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, TaskResult& result);
+	void testRange(size_t index, size_t begin, size_t end, TaskResult& result);
+	//Splits the range of a node into the ranges of its four children
+	void splitRange(uint32_t fromX, uint32_t fromY, uint32_t span, size_t begin, size_t end, size_t* bounds) const;
+	void queryRect(uint32_t level, uint32_t x, uint32_t y, size_t begin, size_t end,
+			uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, const Vector& from, const Vector& to, uint32_t types);
+
+	uint32_t toGrid(double pos, double scale) const;
+	static uint32_t spreadBits(uint32_t value);
+};
+
+
+#endif //SERVER_LINEARQUADTREE_H
@@ -6,75 +6,93 @@
 #include "Gamefield.h"
 
 
-MoveableElement::MoveableElement(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition, const String& mColor,
+MoveableElement::MoveableElement(GamefieldPtr mGamefield, ElementHandle mHandle, ElementType mType, const Vector& mPosition, uint16_t mColor,
 								 double mSize, uint32_t mass, double speed) :
-		Element(mGamefield, mId, mPosition, mColor, mSize, mass), mMaxSpeed(speed) {
-
+		Element(mGamefield, mHandle, mPosition, mColor, mSize, mass), mStore(mGamefield->getElementStore()), mType(mType),
+		mStartSpeed(speed) {
 }
 
-void MoveableElement::update(double timediff) {
-	Element::update(timediff);
-
-	if (mBoostVelocity.x != 0 || mBoostVelocity.y != 0) {
-		double velX = mBoostVelocity.x - mBoostAcceleration * timediff * sign(mBoostVelocity.x);
-		double velY = mBoostVelocity.y - mBoostAcceleration * timediff * sign(mBoostVelocity.y);
-
-		mBoostVelocity.x = sign(velX) == sign(mBoostVelocity.x) ? velX : 0;
-		mBoostVelocity.y = sign(velY) == sign(mBoostVelocity.y) ? velY : 0;
-		changed();
-	}
-
-	//double a = mGamefield->getOptions().player.force / (mMass + 1)
-	double a = mGamefield->getOptions().player.acceleration; //constant acceleration independent of mass
+MoveableElement::~MoveableElement() {
+	removeFromStore();
+}
 
-	if (mIsMoving) {
-		Vector vel = mDirection * a * timediff + mVelocity;
+void MoveableElement::addToStore() {
+	if(mAdded)
+		return;
+	mAdded = true;
+	mStore.add(this);
+}
 
-		mVelocity.x = abs(vel.x) > abs(mMaxSpeed * mBoostFactor * mDirection.x) ? mMaxSpeed * mBoostFactor * mDirection.x : vel.x;
-		mVelocity.y = abs(vel.y) > abs(mMaxSpeed * mBoostFactor * mDirection.y) ? mMaxSpeed * mBoostFactor * mDirection.y : vel.y;
-		//printf("%lf, %lf  %lf\n", mVelocity.x, mVelocity.y, timediff);
-		changed();
-	} else if (mVelocity.x != 0 || mVelocity.y != 0) {
-		double velX = mVelocity.x - a * timediff * sign(mVelocity.x);
-		double velY = mVelocity.y - a * timediff * sign(mVelocity.y);
+void MoveableElement::removeFromStore() {
+	if(mSlot != NO_SLOT)
+		mStore.remove(this);
+}
 
-		mVelocity.x = sign(velX) == sign(mVelocity.x) ? velX : 0;
-		mVelocity.y = sign(velY) == sign(mVelocity.y) ? velY : 0;
+void MoveableElement::moved(const Vector& position, bool hasMoved) {
+	//Replaces Element::update, so changes made after the movement in this tick are kept
+	Element::update(0);
+	Vector lastPosition = mPosition;
+	if (hasMoved) {
 		changed();
-	}
-
-	if (hasChanged()) {
-		//do not let them move outside the gamefield
-		mPosition.x = min(max(mPosition.x + (mVelocity.x + mBoostVelocity.x) * timediff, 0.),
-						  mGamefield->getOptions().width);
-		mPosition.y = min(max(mPosition.y + (mVelocity.y + mBoostVelocity.y) * timediff, 0.),
-						  mGamefield->getOptions().height);
+		mPosition = position;
 		updateRegion();
 	}
+	//Fast elements are also tested along their way
+	setSweep(mPosition - lastPosition);
 }
 
 void MoveableElement::setDirection(const Vector& direction, bool isMoving) {
-	mIsMoving = isMoving;
-	mDirection = direction;
+	if (mAdded)
+		mStore.setDirection(this, direction, isMoving);
+}
+
+Vector MoveableElement::getMoveDirection() const {
+	if (mSlot == NO_SLOT)
+		return Vector::FromAngle(mStartBoost.angle());
+	const ElementStore::Table& table = mStore.getTable(mType);
+	return Vector::FromAngle(Vector(table.velX[mSlot] + table.boostX[mSlot], table.velY[mSlot] + table.boostY[mSlot]).angle());
+}
+
+bool MoveableElement::isMoving() const {
+	if (mSlot == NO_SLOT)
+		return false;
+	return (mStore.getTable(mType).flags[mSlot] & ElementStore::F_Moving) != 0;
 }
 
 void MoveableElement::setBoost(const Vector& velocity, double acceleration) {
-	mBoostVelocity = velocity;
-	mBoostAcceleration = acceleration;
+	if (mAdded) {
+		mStore.setBoost(this, velocity, acceleration);
+		return;
+	}
+	mStartBoost = velocity;
+	mStartBoostAcceleration = acceleration;
 }
 
 void MoveableElement::setBoostFactor(double boost) {
-	mBoostFactor = boost;
+	if (mAdded)
+		mStore.setBoostFactor(this, boost);
+}
+
+void MoveableElement::setMaxSpeed(double speed) {
+	if (mAdded)
+		mStore.setMaxSpeed(this, speed);
+	else
+		mStartSpeed = speed;
 }
 
 double MoveableElement::getSpeed() const {
-	return (mVelocity + mBoostVelocity).lengthSquared();
+	if (mSlot == NO_SLOT)
+		return mStartBoost.lengthSquared();
+	const ElementStore::Table& table = mStore.getTable(mType);
+	return Vector(table.velX[mSlot] + table.boostX[mSlot], table.velY[mSlot] + table.boostY[mSlot]).lengthSquared();
 }
 
 ElementUpdateData MoveableElement::getUpdate() const {
 	ElementUpdateData eud = Element::getUpdate();
-	eud.velX = mVelocity.x + mBoostVelocity.x;
-	eud.velY = mVelocity.y + mBoostVelocity.y;
+	if (mSlot == NO_SLOT)
+		return eud;
+	const ElementStore::Table& table = mStore.getTable(mType);
+	eud.velX = table.velX[mSlot] + table.boostX[mSlot];
+	eud.velY = table.velY[mSlot] + table.boostY[mSlot];
 	return eud;
 }
-
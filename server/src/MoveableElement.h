@@ -6,38 +6,59 @@
 #define AGARIO_MOVEABLEELEMENT_H
 
 #include "Element.h"
+#include "ElementStore.h"
 
 class MoveableElement : public Element {
-protected:
-	double mMaxSpeed = 0;
-
-	Vector mVelocity;
-	Vector mDirection;
-	bool mIsMoving = false;
-
-	Vector mBoostVelocity;
-	double mBoostAcceleration = 0;
-	double mBoostFactor = 1;
+friend class ElementStore;
+public:
+	static const uint32_t NO_SLOT = (uint32_t) -1;
+
+private:
+	//Velocity, direction and boost are kept in the store of the Gamefield
+	ElementStore& mStore;
+	ElementType mType;
+	//NO_SLOT until the store applied the add and after it was destroyed, only used by the simulation thread
+	uint32_t mSlot = NO_SLOT;
+	//Set by addToStore, changes are queued in the store from then on
+	bool mAdded = false;
+	//Set before addToStore, e.g. by the constructors, and copied into the row of the element
+	double mStartSpeed;
+	Vector mStartBoost;
+	double mStartBoostAcceleration = 0;
 
 public:
-	MoveableElement(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition, const String& mColor, double mSize,
+	MoveableElement(GamefieldPtr mGamefield, ElementHandle mHandle, ElementType mType, const Vector& mPosition, uint16_t mColor, double mSize,
 					uint32_t mass = 0, double speed = 0);
-	virtual ~MoveableElement() {}
+	virtual ~MoveableElement();
 
+	//The setters can be called from any thread, the getters only from the simulation thread
 	void setDirection(const Vector& direction, bool isMoving = true);
 
-	Vector getMoveDirection() const { return Vector::FromAngle((mVelocity + mBoostVelocity).angle()); }
+	Vector getMoveDirection() const;
 
-	bool isMoving() const { return mIsMoving; }
+	bool isMoving() const;
 
 	void setBoost(const Vector& velocity, double acceleration);
 	void setBoostFactor(double boost);
+	void setMaxSpeed(double speed);
 
 	virtual double getSpeed() const;
 
+	virtual bool isMoveable() const { return true; }
+
 	virtual ElementUpdateData getUpdate() const;
 
-	virtual void update(double timediff);
+	//Moved with all others by ElementStore::integrate
+	virtual void update(double timediff) {}
+
+	//Called by Gamefield::addElement, the element moves from now on
+	void addToStore();
+	//Removes the movement state, the element does not move any more
+	void removeFromStore();
+
+private:
+	//Called by ElementStore::integrate with the new position
+	void moved(const Vector& position, bool changed);
 };
 
 typedef std::shared_ptr<MoveableElement> MoveableElementPtr;
@@ -42,8 +42,8 @@ template<>
 void applyValue<ElementData>(vector<uint8_t>& dest, const ElementData& ed) {
 	applyValue(dest, ed.id);
 	applyValue(dest, ed.type);
-	applyValue(dest, ed.color);
-	applyValue(dest, ed.name);
+	applyValue(dest, *ed.color);
+	applyValue(dest, *ed.name);
 	applyValue(dest, ed.x);
 	applyValue(dest, ed.y);
 	applyValue(dest, ed.size);
@@ -66,15 +66,11 @@ void StartPacket::parseData(const char* data, uint32_t size) {
 
 void PlayerUpdatePacket::applyData(vector<uint8_t>& buffer) const {
 	//Reserve required bytes
-	buffer.reserve(sizeof(uint32_t) + sizeof(uint32_t)*player->getBalls().size());
-	list<BallPtr> balls = player->getBalls();
-	uint32_t mass = 0;
-	for(BallPtr b : balls) {
-		mass += b->getMass();
-	}
-	applyValue(buffer, mass);
-	for(BallPtr b : balls) {
-		applyValue(buffer, b->getId());
+	const vector<ElementHandle>& balls = player.getBalls();
+	buffer.reserve(sizeof(uint32_t) + sizeof(uint32_t)*balls.size());
+	applyValue(buffer, player.getMass());
+	for(ElementHandle b : balls) {
+		applyValue(buffer, b.getValue());
 	}
 
 }
@@ -82,7 +78,7 @@ void PlayerUpdatePacket::applyData(vector<uint8_t>& buffer) const {
 void SetElementsPacket::applyData(vector<uint8_t>& buffer) const {
 	//Reserve an approximation of required bytes
 	buffer.reserve(sizeof(ElementData) * Elements.size() + 1);
-	for(ElementPtr e : Elements) {
+	for(const ElementPtr& e : Elements) {
 		applyValue(buffer, e->get());
 	}
 }
@@ -96,16 +92,16 @@ void UpdateElementsPacket::applyData(vector<uint8_t>& buffer) const {
 						sizeof(ElementUpdateData) * UpdatedElements.size());
 
 	applyValue(buffer, (uint16_t)NewElements.size());
-	for(ElementPtr e : NewElements) {
+	for(Element* e : NewElements) {
 		applyValue(buffer, e->get());
 	}
 
 	applyValue(buffer, (uint16_t)DeletedElements.size());
-	for(ElementPtr e : DeletedElements) {
+	for(Element* e : DeletedElements) {
 		applyValue(buffer, e->getId());
 	}
 
-	for(ElementPtr e : UpdatedElements) {
+	for(Element* e : UpdatedElements) {
 		applyValue(buffer, e->getUpdate());
 	}
 
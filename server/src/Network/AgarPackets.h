@@ -62,10 +62,10 @@ public:
 
 class PlayerUpdatePacket : public Packet {
 public:
-	PlayerPtr player;
+	const Player& player;
 
 public:
-	PlayerUpdatePacket(PlayerPtr player) : player(player) { }
+	PlayerUpdatePacket(const Player& player) : player(player) { }
 
 	uint8_t getId() const { return PID_PlayerUpdate; }
 
@@ -92,15 +92,16 @@ protected:
 
 class UpdateElementsPacket : public Packet {
 public:
-	const vector<ElementPtr>& NewElements;
-	const vector<ElementPtr>& DeletedElements;
-	const vector<ElementPtr>& UpdatedElements;
+	//Borrowed from the Gamefield, the elements are only freed after the packet is sent
+	const vector<Element*>& NewElements;
+	const vector<Element*>& DeletedElements;
+	const vector<Element*>& UpdatedElements;
 
 private:
 	uint32_t mLength;
 public:
-	UpdateElementsPacket(const vector<ElementPtr>& NewElements, const vector<ElementPtr>& DeletedElements,
-						 const vector<ElementPtr>& UpdatedElements) :
+	UpdateElementsPacket(const vector<Element*>& NewElements, const vector<Element*>& DeletedElements,
+						 const vector<Element*>& UpdatedElements) :
 			NewElements(NewElements), DeletedElements(DeletedElements), UpdatedElements(UpdatedElements) { }
 
 	uint8_t getId() const { return PID_UpdateElements; }
@@ -12,9 +12,12 @@ class Obstracle : public MoveableElement {
 private:
 	int mEatCount = 0;
 public:
-	Obstracle(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition);
+	Obstracle(GamefieldPtr mGamefield, ElementHandle mHandle, const Vector& mPosition, uint16_t mColor);
 
-	virtual bool tryEat(ElementPtr other);
+	//Splits up big Balls
+	bool tryEat(Ball& ball);
+	//Grows and shoots out a new Obstracle after some Shoots
+	bool tryEat(Shoot& shoot);
 
 	virtual ElementType getType() const { return ET_Obstracle; }
 
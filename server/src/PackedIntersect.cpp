@@ -0,0 +1,80 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "PackedIntersect.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static inline uint64_t intersectTail(double x, double y, double size, const double* xs, const double* ys, const double* sizes, size_t begin, size_t count) {
+	uint64_t result = 0;
+	for(size_t i = begin; i < count; i++) {
+		double dist = (x - xs[i]) * (x - xs[i]) + (y - ys[i]) * (y - ys[i]);
+		if(dist <= size * size || dist <= sizes[i] * sizes[i])
+			result |= (uint64_t) 1 << i;
+	}
+	return result;
+}
+
+uint64_t intersectPackedScalar(double x, double y, double size, const double* xs, const double* ys, const double* sizes, size_t count) {
+	assert(count <= PACKED_BATCH);
+	return intersectTail(x, y, size, xs, ys, sizes, 0, count);
+}
+
+#if defined(__AVX__)
+
+uint64_t intersectPacked(double x, double y, double size, const double* xs, const double* ys, const double* sizes, size_t count) {
+	assert(count <= PACKED_BATCH);
+	__m256d px = _mm256_set1_pd(x);
+	__m256d py = _mm256_set1_pd(y);
+	__m256d ps = _mm256_set1_pd(size * size);
+	uint64_t result = 0;
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4) {
+		__m256d dx = _mm256_sub_pd(px, _mm256_loadu_pd(xs + i));
+		__m256d dy = _mm256_sub_pd(py, _mm256_loadu_pd(ys + i));
+		__m256d dist = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+		__m256d s = _mm256_loadu_pd(sizes + i);
+		__m256d hit = _mm256_or_pd(_mm256_cmp_pd(dist, ps, _CMP_LE_OQ), _mm256_cmp_pd(dist, _mm256_mul_pd(s, s), _CMP_LE_OQ));
+		result |= (uint64_t) _mm256_movemask_pd(hit) << i;
+	}
+	return result | intersectTail(x, y, size, xs, ys, sizes, i, count);
+}
+
+const char* getPackedInstructionSet() { return "avx"; }
+
+#elif defined(__SSE2__)
+
+uint64_t intersectPacked(double x, double y, double size, const double* xs, const double* ys, const double* sizes, size_t count) {
+	assert(count <= PACKED_BATCH);
+	__m128d px = _mm_set1_pd(x);
+	__m128d py = _mm_set1_pd(y);
+	__m128d ps = _mm_set1_pd(size * size);
+	uint64_t result = 0;
+	size_t i = 0;
+	for(; i + 2 <= count; i += 2) {
+		__m128d dx = _mm_sub_pd(px, _mm_loadu_pd(xs + i));
+		__m128d dy = _mm_sub_pd(py, _mm_loadu_pd(ys + i));
+		__m128d dist = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+		__m128d s = _mm_loadu_pd(sizes + i);
+		__m128d hit = _mm_or_pd(_mm_cmple_pd(dist, ps), _mm_cmple_pd(dist, _mm_mul_pd(s, s)));
+		result |= (uint64_t) _mm_movemask_pd(hit) << i;
+	}
+	return result | intersectTail(x, y, size, xs, ys, sizes, i, count);
+}
+
+const char* getPackedInstructionSet() { return "sse2"; }
+
+#else
+
+uint64_t intersectPacked(double x, double y, double size, const double* xs, const double* ys, const double* sizes, size_t count) {
+	return intersectPackedScalar(x, y, size, xs, ys, sizes, count);
+}
+
+const char* getPackedInstructionSet() { return "scalar"; }
+
+#endif
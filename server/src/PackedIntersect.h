@@ -0,0 +1,27 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_PACKEDINTERSECT_H
+#define SERVER_PACKEDINTERSECT_H
+
+#include "GlobalDefs.h"
+
+//Circles tested in one call
+#define PACKED_BATCH 64
+
+/*
+ * Tests one circle against up to PACKED_BATCH circles stored as separate x, y and size arrays.
+ * Same rule as QuadTreeNode::intersect (the center of one circle is inside the other one),
+ * bit i of the result is set if circle i intersects.
+ * Uses AVX if built with -DAVX=ON, else SSE2 if the compiler targets it, otherwise the scalar version.
+ */
+uint64_t intersectPacked(double x, double y, double size, const double* xs, const double* ys, const double* sizes, size_t count);
+
+uint64_t intersectPackedScalar(double x, double y, double size, const double* xs, const double* ys, const double* sizes, size_t count);
+
+//Name of the instruction set used by intersectPacked
+const char* getPackedInstructionSet();
+
+
+#endif //SERVER_PACKEDINTERSECT_H
@@ -0,0 +1,23 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "Palette.h"
+
+Palette::Palette(const vector<String>& values) {
+	for(const String& value : values) {
+		if(std::find(mValues.begin(), mValues.end(), value) != mValues.end())
+			continue;
+		if(mValues.size() >= MAX_SIZE) {
+			fprintf(stderr, "Palette is full, using the first entry for %s\n", value.c_str());
+			continue;
+		}
+		mValues.push_back(value);
+	}
+}
+
+uint16_t Palette::indexOf(const String& value) const {
+	//Only while the Gamefield is created, there are just a few colors
+	auto it = std::find(mValues.begin(), mValues.end(), value);
+	return it == mValues.end() ? 0 : (uint16_t) (it - mValues.begin());
+}
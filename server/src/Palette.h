@@ -0,0 +1,35 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_PALETTE_H
+#define SERVER_PALETTE_H
+
+#include "GlobalDefs.h"
+
+/*
+ * Interned strings of one Gamefield, the colors. Elements keep the index and ElementData
+ * points to the entry, so neither copies the string.
+ * Filled once from the options and never changed afterwards, so get does not lock.
+ */
+class Palette {
+public:
+	static const uint32_t MAX_SIZE = 65536;
+
+private:
+	vector<String> mValues;
+
+public:
+	//Duplicates are kept once
+	Palette(const vector<String>& values);
+
+	//Index of a string passed to the constructor, 0 if it was not
+	uint16_t indexOf(const String& value) const;
+
+	const String& get(uint16_t index) const { return mValues[index]; }
+
+	size_t size() const { return mValues.size(); }
+};
+
+
+#endif //SERVER_PALETTE_H
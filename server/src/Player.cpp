@@ -11,7 +11,7 @@
 using std::placeholders::_1;
 using std::placeholders::_2;
 
-Player::Player(GamefieldPtr mGamefield, ClientPtr mClient, const String& mColor, const String& mName) :
+Player::Player(GamefieldPtr mGamefield, ClientPtr mClient, uint16_t mColor, const String& mName) :
 		mClient(mClient), mGamefield(mGamefield), mColor(mColor), mName(mName)
 {
 	//Set Callbacks
@@ -21,7 +21,9 @@ Player::Player(GamefieldPtr mGamefield, ClientPtr mClient, const String& mColor,
 }
 
 void Player::setTarget(const Vector& target) {
-	for (BallPtr ball : mBalls) {
+	for (ElementHandle handle : mBalls) {
+		Ball* ball = getBallRaw(handle);
+		if (!ball) continue;
 		Vector t = target - (ball->getPosition() - mPosition);
 		if (t.lengthSquared() < ball->getSize() * ball->getSize() / 4)
 			ball->setDirection(Vector::ZERO, false); //Stop moving
@@ -31,8 +33,10 @@ void Player::setTarget(const Vector& target) {
 }
 
 void Player::splitUp(const Vector& target) {
-	list<BallPtr> balls = mBalls; //Store list here because new balls will be added
-	for (BallPtr ball : balls) {
+	vector<ElementHandle> balls = mBalls; //Store list here because new balls will be added
+	for (ElementHandle handle : balls) {
+		BallPtr ball = getBall(handle);
+		if (!ball) continue;
 		if (ball->getMass() > mGamefield->getOptions().player.minSplitMass) {
 			Vector t = target - (ball->getPosition() - mPosition);
 			ball->splitUp(Vector::FromAngle(t.angle()));
@@ -42,7 +46,9 @@ void Player::splitUp(const Vector& target) {
 }
 
 void Player::shoot(const Vector& target) {
-	for (BallPtr ball : mBalls) {
+	for (ElementHandle handle : mBalls) {
+		BallPtr ball = getBall(handle);
+		if (!ball) continue;
 		if (ball->getMass() > mGamefield->getOptions().player.minSplitMass) {
 			Vector t = target - (ball->getPosition() - mPosition);
 			ball->shoot(Vector::FromAngle(t.angle()));
@@ -51,17 +57,14 @@ void Player::shoot(const Vector& target) {
 	updateClient();
 }
 
-void Player::addBall(BallPtr ball) {
+void Player::addBall(ElementHandle ball) {
 	mBalls.push_back(ball);
 }
 
-void Player::removeBall(uint32_t ball) {
-	for (auto it = mBalls.begin(); it != mBalls.end(); it++) {
-		if ((*it)->getId() == ball) {
-			mBalls.erase(it);
-			break;
-		}
-	}
+void Player::removeBall(ElementHandle ball) {
+	auto it = std::find(mBalls.begin(), mBalls.end(), ball);
+	if (it != mBalls.end())
+		mBalls.erase(it);
 	if (mBalls.empty()) {
 		mClient->emit(std::make_shared<EmptyPacket<PID_RIP> >());
 	}
@@ -71,7 +74,9 @@ void Player::update(double /*timediff*/) {
 	mPosition = Vector::ZERO;
 	double size = 0;
 	//Center of Player in the middle of its balls weighted by size
-	for (BallPtr ball : mBalls) {
+	for (ElementHandle handle : mBalls) {
+		Ball* ball = getBallRaw(handle);
+		if (!ball) continue;
 		mPosition += ball->getPosition() * ball->getSize();
 		size += ball->getSize();
 	}
@@ -79,6 +84,24 @@ void Player::update(double /*timediff*/) {
 	setTarget(mTarget);
 }
 
+uint32_t Player::getMass() const {
+	uint32_t mass = 0;
+	for (ElementHandle handle : mBalls) {
+		BallPtr ball = getBall(handle);
+		if (!ball) continue;
+		mass += ball->getMass();
+	}
+	return mass;
+}
+
+BallPtr Player::getBall(ElementHandle handle) const {
+	return mGamefield->lockElement<Ball>(handle);
+}
+
+Ball* Player::getBallRaw(ElementHandle handle) const {
+	return mGamefield->getElement<Ball>(handle);
+}
+
 void Player::onSplitUp(ClientPtr client, PacketPtr packet) {
 	splitUp(mTarget);
 }
@@ -90,9 +113,8 @@ void Player::onShoot(ClientPtr client, PacketPtr packet) {
 void Player::onUpdateTarget(ClientPtr client, PacketPtr packet) {
 	auto p = std::dynamic_pointer_cast<StructPacket<PID_UpdateTarget, TargetPacket> >(packet);
 	mTarget = Vector((*p)->x, (*p)->y);
-	setTarget(mTarget);
 }
 
 void Player::updateClient() {
-	mClient->emit(std::make_shared<PlayerUpdatePacket>(shared_from_this()));
+	mClient->emit(std::make_shared<PlayerUpdatePacket>(*this));
 }
@@ -7,42 +7,54 @@
 
 #include "GlobalDefs.h"
 #include "Vector.h"
+#include "ElementHandle.h"
 
 class Player : public std::enable_shared_from_this<Player> {
 private:
 	ClientPtr mClient;
 	GamefieldPtr mGamefield;
-	list<BallPtr> mBalls;
-	String mColor;
+	//The Balls are owned by the Gamefield, destroyed ones are removed by it
+	vector<ElementHandle> mBalls;
+	//Index in the colors of the Gamefield
+	uint16_t mColor;
 	Vector mPosition;
 	Vector mTarget;
+	//Not interned, names are chosen by the clients and would never be released
 	String mName;
 
 public:
 
 
-	Player(GamefieldPtr mGamefield, ClientPtr mClient, const String& mColor, const String& mName);
+	Player(GamefieldPtr mGamefield, ClientPtr mClient, uint16_t mColor, const String& mName);
 
-	String getColor() const { return mColor; }
-	String getName() const { return mName; }
+	uint16_t getColor() const { return mColor; }
+	const String& getName() const { return mName; }
 
+	//Only on the simulation thread, the target of the client is applied by update
 	void setTarget(const Vector& target);
 
 	void splitUp(const Vector& target);
 
 	void shoot(const Vector& target);
 
-	void addBall(BallPtr ball);
+	void addBall(ElementHandle ball);
 
-	void removeBall(uint32_t ball);
+	void removeBall(ElementHandle ball);
 
-	list<BallPtr> getBalls() const { return mBalls; }
+	const vector<ElementHandle>& getBalls() const { return mBalls; }
+
+	uint32_t getMass() const;
 
 	void updateClient();
 
 	void update(double timediff);
 
 private:
+	//NULL if the Ball was destroyed, owning because the commands of the client run on the network threads
+	BallPtr getBall(ElementHandle handle) const;
+	//Same without the reference count, only on the simulation thread that destroys the Balls
+	Ball* getBallRaw(ElementHandle handle) const;
+
 	void onSplitUp(ClientPtr client, PacketPtr packet);
 
 	void onShoot(ClientPtr client, PacketPtr packet);
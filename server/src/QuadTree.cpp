@@ -3,364 +3,797 @@
 //
 
 #include "QuadTree.h"
+#include "PackedIntersect.h"
 
-QuadTree::QuadTree(const Vector& mPosition, const Vector& mSize, std::function<void(QuadTreeNodePtr, QuadTreeNodePtr)> mCollisionCallback, size_t mMaxAmount, QuadTreePtr mParent)  :
-		mParent(mParent), mPosition(mPosition), mSize(mSize), mMaxAmount(mMaxAmount), mCollisionCallback(mCollisionCallback)
+QuadTree::QuadTree(const Vector& mPosition, const Vector& mSize, size_t mSplitAmount, size_t mCombineAmount, double mLooseness)  :
+		mSplitAmount(mSplitAmount), mCombineAmount(min(mCombineAmount, mSplitAmount)), mLooseness(mLooseness)
 {
-	//printf("Created Region %lf, %lf x %lf, %lf\n", mPosition.x, mPosition.y, mPosition.x+mSize.x, mPosition.y+mSize.y);
-	mElements.reserve(mMaxAmount);
+	//The head uses a whole block, so the blocks of children never cross a chunk
+	uint32_t head = allocateBlock();
+	assert(head == ROOT);
+	Node& root = getNode(head);
+	root.position = mPosition;
+	root.size = mSize;
+	root.elements.reserve(mSplitAmount);
+	mSplitBuffer.reserve(mSplitAmount);
+	mUsedNodes = 1;
 }
 
-void QuadTree::doCollisionCheck() {
-	list<QuadTreePtr> neighbours = getNeighbours();
+void QuadTree::findCollisions() {
+	if(mRebuild) {
+		collectElements(ROOT);
+		{
+			lock_guard<mutex> _lock(mPendingMutex);
+			mBuildElements.insert(mBuildElements.end(), mPending.begin(), mPending.end());
+			mPending.clear();
+		}
+		build(ROOT, 0, mBuildElements.size(), 0);
+		mBuildElements.clear();
+	} else {
+		insertPending();
+		restructure();
+	}
+	mPackedX.clear();
+	mPackedY.clear();
+	mPackedSize.clear();
+	updatePacked(ROOT);
+
+	//The tree is not changed until all tasks are done
+	mTasks.clear();
+	collectTasks(ROOT);
+	runTasks(mTasks.size(), [this] (size_t i, TaskResult& result) {
+		if(mTasks[i].subtree)
+			checkSubtree(mTasks[i].node, result);
+		else
+			checkNode(mTasks[i].node, result);
+	});
+}
 
-	//start checking of children
-	if(!mIsLeaf) {
-		mChilds[0]->doCollisionCheck();
-		mChilds[1]->doCollisionCheck();
-		mChilds[2]->doCollisionCheck();
-		mChilds[3]->doCollisionCheck();
+void QuadTree::collectTasks(uint32_t node) {
+	//Big subtrees are split up, the nodes above them are checked on their own
+	const Node& n = getNode(node);
+	if(n.isLeaf() || n.count <= TASK_SIZE) {
+		mTasks.push_back(Task {node, true});
+		return;
 	}
+	mTasks.push_back(Task {node, false});
+	for(uint32_t i = 0; i < 4; i++)
+		collectTasks(n.childs + i);
+}
 
-	vector<QuadTreeNodePtr> oldList;
-	{
-		lock_guard<mutex> _lock(mMutex);
-		oldList = mElements;
+void QuadTree::checkSubtree(uint32_t node, TaskResult& result) {
+	//start checking of children
+	if(!getNode(node).isLeaf()) {
+		uint32_t childs = getNode(node).childs;
+		checkSubtree(childs + 0, result);
+		checkSubtree(childs + 1, result);
+		checkSubtree(childs + 2, result);
+		checkSubtree(childs + 3, result);
 	}
+	checkNode(node, result);
+}
+
+void QuadTree::checkNode(uint32_t node, TaskResult& result) {
+	if(mLooseness > 1)
+		doLooseCollisionCheck(node, result);
+	else
+		doCollisionCheck(node, result);
+}
 
-	for(size_t i = 0; i < oldList.size(); i++) {
-		QuadTreeNodePtr& e1 = oldList[i];
+void QuadTree::doCollisionCheck(uint32_t node, TaskResult& result) {
+	//Every node is checked by one task only, so it can fill its own cache
+	Node& n = getNode(node);
+	if(n.neighbourCount == NO_NEIGHBOURS)
+		n.neighbourCount = findNeighbours(node, n.neighbours);
+
+	for(size_t i = 0; i < n.elements.size(); i++) {
+		QuadTreeNodePtr e1 = n.elements[i];
 		if(e1->isDeleted()) continue;
 		//Start at i + 1 because we already checked these before
-		for(size_t j = i + 1; j < oldList.size(); j++) {
-			QuadTreeNodePtr& e2 = oldList[j];
-			assert(e1 != e2);
-			if(e1->isDeleted() || e2->isDeleted()) continue;
-			if(e1->intersect(e2)) {
-				mCollisionCallback(e1, e2);
-			}
-		}
+		testElements(node, i + 1, e1, false, result);
 		//Pass to children
-		if(!mIsLeaf) {
-			mChilds[0]->checkCollision(e1);
-			mChilds[1]->checkCollision(e1);
-			mChilds[2]->checkCollision(e1);
-			mChilds[3]->checkCollision(e1);
+		if(!n.isLeaf()) {
+			checkCollision(n.childs + 0, e1, result);
+			checkCollision(n.childs + 1, e1, result);
+			checkCollision(n.childs + 2, e1, result);
+			checkCollision(n.childs + 3, e1, result);
 		}
 		//Pass to neighbours
-		for(QuadTreePtr& qt : neighbours)
-			qt->checkCollision(e1);
+		for(uint8_t k = 0; k < n.neighbourCount; k++)
+			checkCollision(n.neighbours[k], e1, result);
 	}
+}
 
-
+void QuadTree::testElements(uint32_t node, size_t begin, QuadTreeNodePtr e1, bool ordered, TaskResult& result) {
+	const Node& n = getNode(node);
+	const Vector& pos = e1->getPosition();
+	double size = e1->getSize();
+	for(size_t i = begin; i < n.elements.size(); i += PACKED_BATCH) {
+		size_t count = min(n.elements.size() - i, (size_t) PACKED_BATCH);
+		size_t packed = n.packed + i;
+		uint64_t hits = intersectPacked(pos.x, pos.y, size, &mPackedX[packed], &mPackedY[packed], &mPackedSize[packed], count);
+		result.pairTests += count;
+		for(; hits; hits &= hits - 1) {
+			QuadTreeNodePtr e2 = n.elements[i + __builtin_ctzll(hits)];
+			assert(e1 != e2);
+			//Only the bigger one reports the pair
+			if(ordered && (e2->getSize() > size || (e2->getSize() == size && e2 < e1))) continue;
+			if(e2->isDeleted()) continue;
+			if(!e1->canCollide(e2)) {
+				result.drop(e1->getCollisionType(), e2->getCollisionType());
+				continue;
+			}
+			result.pairs.push_back(CollisionPair {e1, e2});
+		}
+	}
 }
 
 bool QuadTree::add(QuadTreeNodePtr elem) {
-	if(isInside(elem)) { //Contains point and fits inside
-		if(mIsLeaf && mElements.size() < mMaxAmount) { //Still some space left
-			{
-				lock_guard<mutex> _lock(mMutex);
-				/*for(QuadTreeNodePtr& e : mElements)
-					if(e == elem)
-						printf("Double Element in TreeNode!!! %p\n", e);*/
-
-				mElements.push_back(elem);
-			}
-			if(elem->mRegion)
-				elem->mRegion->remove(elem);
-			elem->mRegion = this;
-			//printf("Added to Region %lf, %lf x %lf, %lf\n", mPosition.x, mPosition.y, mPosition.x+mSize.x, mPosition.y+mSize.y);
-		} else { // No space left
-			if(mIsLeaf)
-				split();
-			//Try to add it to a child
-			if(!(mChilds[0]->add(elem) || mChilds[1]->add(elem) || mChilds[2]->add(elem) || mChilds[3]->add(elem))) {
-				//Otherwise add it to this node anyway (it is probably to big for the children)
-				{
-					lock_guard<mutex> _lock(mMutex);
-					/*for(QuadTreeNodePtr& e : mElements)
-						if(e == elem)
-							printf("Double2 Element in TreeNode!!! %p\n", e);*/
-
-					mElements.push_back(elem);
-				}
-				if(elem->mRegion)
-					elem->mRegion->remove(elem);
-				elem->mRegion = this;
-				//printf("Added to own Region %lf, %lf x %lf, %lf\n", mPosition.x, mPosition.y, mPosition.x+mSize.x, mPosition.y+mSize.y);
-			}
+	lock_guard<mutex> _lock(mPendingMutex);
+	elem->mBroadphase = this;
+	elem->mProxy = PENDING;
+	mPending.push_back(elem);
+	return true;
+}
+
+void QuadTree::insertPending() {
+	{
+		lock_guard<mutex> _lock(mPendingMutex);
+		mInserting.swap(mPending);
+	}
+	for(QuadTreeNodePtr elem : mInserting) {
+		elem->mProxy = NO_NODE;
+		if(!insert(ROOT, elem)) {
+			fprintf(stderr, "Can not insert element at %.0lf, %.0lf\n", elem->mPosition.x, elem->mPosition.y);
+			elem->mBroadphase = NULL;
 		}
-		return true;
 	}
-	return false;
+	mInserting.clear();
+}
+
+void QuadTree::endTraversal() {
+	if(--mTraversals > 0)
+		return;
+	for(size_t i = 0; i < mDeferred.size(); i++) {
+		if(mDeferred[i].remove)
+			remove(mDeferred[i].elem);
+		else if(mDeferred[i].elem->mBroadphase == this) //Not removed before
+			update(mDeferred[i].elem);
+	}
+	mDeferred.clear();
 }
 
 bool QuadTree::remove(QuadTreeNodePtr elem) {
-	//if(isInside(elem)) {
-		bool found = false;
-		{
-			lock_guard<mutex> _lock(mMutex);
+	if(elem->mProxy == PENDING) {
+		lock_guard<mutex> _lock(mPendingMutex);
+		auto it = std::find(mPending.begin(), mPending.end(), elem);
+		if(it == mPending.end())
+			return false;
+		mPending.erase(it);
+		elem->mProxy = NO_NODE;
+		elem->mBroadphase = NULL;
+		return true;
+	}
+	if(mTraversals > 0) {
+		mDeferred.push_back(Deferred {elem, true});
+		return true;
+	}
+	bool found = false;
+	if(elem->mProxy != NO_NODE) {
+		found = erase(elem->mProxy, elem);
+		if(!found)
+			fprintf(stderr, "Elem is not inside its own Region %p\n", elem);
+	}
+	if(!found)
+		found = erase(ROOT, elem);
+	elem->mProxy = NO_NODE;
+	elem->mBroadphase = NULL;
+	return found;
+}
 
-			auto it = mElements.begin();
-			while (it != mElements.end()) {
-				if (*it == elem)
-					break;
-				it++;
-			}
-			if (it != mElements.end()) {
-				*it = mElements.back();
-				mElements.pop_back();
-				found = true;
-			}
+void QuadTree::update(QuadTreeNodePtr elem) {
+	//Inserted at its current position anyway
+	if(elem->mProxy == PENDING || mRebuild)
+		return;
+	if(elem->mProxy == NO_NODE) {
+		printf("Element is not in a Region\n");
+		return;
+	}
+	if(mTraversals > 0) {
+		mDeferred.push_back(Deferred {elem, false});
+		return;
+	}
+	if(!isInside(elem->mProxy, elem)) {
+		//Climb to the smallest node that still contains it and go down from there
+		uint32_t node = getNode(elem->mProxy).parent;
+		while(node != NO_NODE && node != ROOT && !isInside(node, elem))
+			node = getNode(node).parent;
+		mRelocations++;
+		if(node == NO_NODE || !insert(node, elem)) {
+			//Should never appear
+			fprintf(stderr, "Can not find Region for position %.0lf, %.0lf\n", elem->mPosition.x, elem->mPosition.y);
+			assert(false);
 		}
-		if(found) {
-			if(mElements.empty()) {
-				if(mIsLeaf && mParent)
-					mParent->combine();
-				else
-					combine();
-			}
-			return true;
-		} else
-		if (!mIsLeaf) {
-			return  mChilds[0]->remove(elem) ||
-					mChilds[1]->remove(elem) ||
-					mChilds[2]->remove(elem) ||
-					mChilds[3]->remove(elem);
+	}
+}
+
+bool QuadTree::insert(uint32_t node, QuadTreeNodePtr elem) {
+	if(isInside(node, elem)) { //Contains point and fits inside
+		Node& n = getNode(node);
+		//Try to add it to a child, otherwise add it to this node anyway (it is probably to big for the children)
+		if(n.isLeaf() || !(insert(n.childs + 0, elem) || insert(n.childs + 1, elem) || insert(n.childs + 2, elem) || insert(n.childs + 3, elem))) {
+			//Erased first, it uses the slot in the old node
+			if(elem->mProxy != NO_NODE)
+				erase(elem->mProxy, elem);
+			pushElement(node, elem);
+			addCount(node, 1);
+			//No space left, it is split with the next check
+			if(n.isLeaf() && n.elements.size() > mSplitAmount)
+				markDirty(node);
 		}
-	//}
+		return true;
+	}
 	return false;
 }
 
+void QuadTree::pushElement(uint32_t node, QuadTreeNodePtr elem) {
+	Node& n = getNode(node);
+	elem->mProxy = node;
+	elem->mNodeSlot = (uint32_t) n.elements.size();
+	n.elements.push_back(elem);
+}
+
+bool QuadTree::erase(uint32_t node, QuadTreeNodePtr elem) {
+	Node& n = getNode(node);
+	size_t slot = elem->mNodeSlot;
+	//Only searched if it is not in this node, e.g. removed from the root as fallback
+	if(slot >= n.elements.size() || n.elements[slot] != elem)
+		slot = std::find(n.elements.begin(), n.elements.end(), elem) - n.elements.begin();
+	if(slot < n.elements.size()) {
+		//Swap with last element then pop last
+		n.elements[slot] = n.elements.back();
+		n.elements[slot]->mNodeSlot = (uint32_t) slot;
+		n.elements.pop_back();
+		addCount(node, -1);
+		//Parents may be combined with the next check
+		if(n.parent != NO_NODE)
+			markDirty(n.parent);
+		return true;
+	} else
+	if (!n.isLeaf()) {
+		return  erase(n.childs + 0, elem) ||
+				erase(n.childs + 1, elem) ||
+				erase(n.childs + 2, elem) ||
+				erase(n.childs + 3, elem);
+	}
+	return false;
+}
 
-size_t QuadTree::getElementCount() const {
-	if(mIsLeaf)
-		return mElements.size();
-	return mElements.size() +
-		   mChilds[0]->getElementCount() +
-		   mChilds[1]->getElementCount() +
-		   mChilds[2]->getElementCount() +
-		   mChilds[3]->getElementCount();
+void QuadTree::addCount(uint32_t node, int32_t amount) {
+	for(; node != NO_NODE; node = getNode(node).parent)
+		getNode(node).count += amount;
 }
 
+void QuadTree::markDirty(uint32_t node) {
+	Node& n = getNode(node);
+	if(!n.dirty && !mRebuild) {
+		n.dirty = true;
+		mDirty.push_back(node);
+	}
+}
 
-size_t QuadTree::getChildCount() const {
-	return mIsLeaf ? 1 : 1 +
-						 mChilds[0]->getChildCount() +
-						 mChilds[1]->getChildCount() +
-						 mChilds[2]->getChildCount() +
-						 mChilds[3]->getChildCount();
+void QuadTree::restructure() {
+	//Splits may queue their children, so the size is checked every time
+	for(size_t i = 0; i < mDirty.size(); i++) {
+		uint32_t node = mDirty[i];
+		Node& n = getNode(node);
+		n.dirty = false;
+		//Freed by a combine before
+		if(node != ROOT && n.parent == NO_NODE)
+			continue;
+
+		//Combine the biggest subtree that got small enough
+		uint32_t top = NO_NODE;
+		for(uint32_t p = node; p != NO_NODE; p = getNode(p).parent)
+			if(!getNode(p).isLeaf() && getNode(p).count <= mCombineAmount)
+				top = p;
+		if(top != NO_NODE)
+			combine(top);
+		else if(n.isLeaf() && n.elements.size() > mSplitAmount)
+			split(node);
+	}
+	mDirty.clear();
 }
 
-void QuadTree::checkCollision(QuadTreeNodePtr e1) {
-	if(intersects(e1)) { //Only check if the element actually intersects this area
-		vector<QuadTreeNodePtr> oldList;
-		{
-			lock_guard<mutex> _lock(mMutex);
-			oldList = mElements;
-		}
+void QuadTree::checkCollision(uint32_t node, QuadTreeNodePtr e1, TaskResult& result) {
+	//Only check if the element actually intersects this area and can interact with anything in it
+	if((getNode(node).types & e1->getCollisionMask()) && intersects(node, e1, e1->getSize())) {
+		const Node& n = getNode(node);
 		//Compare with own elements
-		for(QuadTreeNodePtr e2 : oldList) {
-			assert(e1 != e2);
-			if(e1->isDeleted() || e2->isDeleted()) continue;
-			if(e1->intersect(e2)) {
-				mCollisionCallback(e1, e2);
-			}
-		}
+		testElements(node, 0, e1, false, result);
 		//Pass to children
-		if(!mIsLeaf) {
-			mChilds[0]->checkCollision(e1);
-			mChilds[1]->checkCollision(e1);
-			mChilds[2]->checkCollision(e1);
-			mChilds[3]->checkCollision(e1);
+		if(!n.isLeaf()) {
+			checkCollision(n.childs + 0, e1, result);
+			checkCollision(n.childs + 1, e1, result);
+			checkCollision(n.childs + 2, e1, result);
+			checkCollision(n.childs + 3, e1, result);
 		}
 	}
 }
 
-void QuadTree::split() {
-	if(mIsLeaf) {
-		//mChilds[NW] = make_shared<QuadTree>(mPosition, mSize/2, mCollisionCallback, mMaxAmount, shared_from_this());
-		//mChilds[NE] = make_shared<QuadTree>(mPosition + Vector(mSize.x/2, 0), mSize/2, mCollisionCallback, mMaxAmount, shared_from_this());
-		//mChilds[SW] = make_shared<QuadTree>(mPosition + Vector(0, mSize.y/2), mSize/2, mCollisionCallback, mMaxAmount, shared_from_this());
-		//mChilds[SE] = make_shared<QuadTree>(mPosition + mSize/2, mSize/2, mCollisionCallback, mMaxAmount, shared_from_this());
-		mChilds[NW] = new QuadTree(mPosition, mSize/2, mCollisionCallback, mMaxAmount, this);
-		mChilds[NE] = new QuadTree(mPosition + Vector(mSize.x/2, 0), mSize/2, mCollisionCallback, mMaxAmount, this);
-		mChilds[SW] = new QuadTree(mPosition + Vector(0, mSize.y/2), mSize/2, mCollisionCallback, mMaxAmount, this);
-		mChilds[SE] = new QuadTree(mPosition + mSize/2, mSize/2, mCollisionCallback, mMaxAmount, this);
+double QuadTree::updatePacked(uint32_t node) {
+	//Elements move and change their size every tick, so this is done before every check.
+	//Nodes are visited depth first, so every subtree ends up in one block
+	Node& n = getNode(node);
+	n.packed = (uint32_t) mPackedX.size();
+	double size = 0;
+	n.types = 0;
+	for(QuadTreeNodePtr e : n.elements) {
+		mPackedX.push_back(e->getPosition().x);
+		mPackedY.push_back(e->getPosition().y);
+		mPackedSize.push_back(e->getSize());
+		size = max(size, e->getSize());
+		n.types |= 1u << e->getCollisionType();
+	}
+	if(!n.isLeaf()) {
+		for(uint32_t i = 0; i < 4; i++) {
+			size = max(size, updatePacked(n.childs + i));
+			n.types |= getNode(n.childs + i).types;
+		}
+	}
+	n.maxSize = size;
+	return size;
+}
 
-		vector<QuadTreeNodePtr> oldList;
-		{
-			lock_guard<mutex> _lock(mMutex);
-			oldList = std::move(mElements);
-			mElements.clear();
+void QuadTree::doLooseCollisionCheck(uint32_t node, TaskResult& result) {
+	const Node& n = getNode(node);
+
+	for(size_t i = 0; i < n.elements.size(); i++) {
+		QuadTreeNodePtr e1 = n.elements[i];
+		if(e1->isDeleted()) continue;
+		//Start at i + 1 because we already checked these before
+		testElements(node, i + 1, e1, false, result);
+		//Pass to children
+		if(!n.isLeaf()) {
+			checkLooseCollision(n.childs + 0, e1, false, result);
+			checkLooseCollision(n.childs + 1, e1, false, result);
+			checkLooseCollision(n.childs + 2, e1, false, result);
+			checkLooseCollision(n.childs + 3, e1, false, result);
+		}
+		//Pass to the siblings of this node and of all its parents.
+		//Elements in there also find e1 on their way, so only the bigger one tests the pair
+		for(uint32_t c = node; getNode(c).parent != NO_NODE; c = getNode(c).parent) {
+			uint32_t siblings = getNode(getNode(c).parent).childs;
+			for(uint32_t k = 0; k < 4; k++)
+				if(siblings + k != c)
+					checkLooseCollision(siblings + k, e1, true, result);
 		}
-		for(QuadTreeNodePtr& elem : oldList) {
-			if(!(mChilds[0]->add(elem) || mChilds[1]->add(elem) || mChilds[2]->add(elem) || mChilds[3]->add(elem))) {
-				lock_guard<mutex> _lock(mMutex);
-				mElements.push_back(elem);
+	}
+}
+
+void QuadTree::checkLooseCollision(uint32_t node, QuadTreeNodePtr e1, bool ordered, TaskResult& result) {
+	//Elements only intersect if one center is inside the other element. If e1 is the bigger one
+	//the center of the other one is inside this area, otherwise it may be up to maxSize outside
+	if((getNode(node).types & e1->getCollisionMask()) && intersects(node, e1, ordered ? e1->getSize() : max(e1->getSize(), getNode(node).maxSize))) {
+		const Node& n = getNode(node);
+		testElements(node, 0, e1, ordered, result);
+		if(!n.isLeaf()) {
+			checkLooseCollision(n.childs + 0, e1, ordered, result);
+			checkLooseCollision(n.childs + 1, e1, ordered, result);
+			checkLooseCollision(n.childs + 2, e1, ordered, result);
+			checkLooseCollision(n.childs + 3, e1, ordered, result);
+		}
+	}
+}
+
+uint32_t QuadTree::allocateBlock() {
+	if(!mFreeBlocks.empty()) {
+		uint32_t first = mFreeBlocks.back();
+		mFreeBlocks.pop_back();
+		mUsedNodes += 4;
+		return first;
+	}
+	uint32_t first = mNodeCount;
+	if((first >> CHUNK_BITS) >= mChunks.size())
+		mChunks.emplace_back(new Node[CHUNK_SIZE]);
+	mNodeCount += 4;
+	mUsedNodes += 4;
+	return first;
+}
+
+void QuadTree::freeBlock(uint32_t first) {
+	//Keep the element buffers, they are reused by the next split
+	for(uint32_t i = 0; i < 4; i++) {
+		Node& n = getNode(first + i);
+		n.elements.clear();
+		n.parent = NO_NODE;
+		n.childs = NO_NODE;
+		n.count = 0;
+		n.neighbourCount = NO_NEIGHBOURS;
+	}
+	mFreeBlocks.push_back(first);
+	mUsedNodes -= 4;
+}
+
+void QuadTree::split(uint32_t node) {
+	if(getNode(node).isLeaf()) {
+		invalidateNeighbours(node);
+		uint32_t childs = createChilds(node);
+		Node& n = getNode(node);
+
+		//The subtree keeps its count, so the elements are moved without insert
+		mSplitBuffer.swap(n.elements);
+		n.elements.clear();
+		n.childs = childs;
+		for(QuadTreeNodePtr elem : mSplitBuffer) {
+			uint32_t target = node;
+			for(uint32_t i = 0; i < 4; i++) {
+				if(isInside(childs + i, elem)) {
+					target = childs + i;
+					break;
+				}
 			}
+			pushElement(target, elem);
+			if(target != node)
+				getNode(target).count++;
 		}
-		mIsLeaf = false;
+		mSplitBuffer.clear();
+
+		//Children that got too full are split in the same pass
+		for(uint32_t i = 0; i < 4; i++)
+			if(getNode(childs + i).elements.size() > mSplitAmount)
+				markDirty(childs + i);
 	}
 }
 
+uint32_t QuadTree::createChilds(uint32_t node) {
+	uint32_t childs = allocateBlock();
+	const Node& n = getNode(node);
+	Vector half = n.size / 2;
+	Vector offsets[4];
+	offsets[NW] = Vector(0, 0);
+	offsets[NE] = Vector(half.x, 0);
+	offsets[SW] = Vector(0, half.y);
+	offsets[SE] = half;
+	for(uint32_t i = 0; i < 4; i++) {
+		Node& c = getNode(childs + i);
+		c.position = n.position + offsets[i];
+		c.size = half;
+		c.parent = node;
+		c.childs = NO_NODE;
+		c.maxSize = 0;
+		c.count = 0;
+		c.neighbourCount = NO_NEIGHBOURS;
+	}
+	return childs;
+}
+
+void QuadTree::collectElements(uint32_t node) {
+	Node& n = getNode(node);
+	mBuildElements.insert(mBuildElements.end(), n.elements.begin(), n.elements.end());
+	n.elements.clear();
+	n.count = 0;
+	n.neighbourCount = NO_NEIGHBOURS;
+	if(!n.isLeaf()) {
+		for(uint32_t i = 0; i < 4; i++)
+			collectElements(n.childs + i);
+		freeBlock(n.childs);
+		n.childs = NO_NODE;
+	}
+}
 
-void QuadTree::combine() {
-	if(!mIsLeaf) {
-		if(getElementCount() < mMaxAmount / 2) {
-			printf("Combining Nodes %ld Elems: %ld\n", getChildCount(), getElementCount());
-			for(int i = 0; i < 4; i++)
-				mChilds[i]->combine();
+void QuadTree::build(uint32_t node, size_t begin, size_t end, uint32_t depth) {
+	Node& n = getNode(node);
+	n.count = (uint32_t) (end - begin);
+	if(n.count > mSplitAmount && depth < MAX_DEPTH) {
+		uint32_t childs = createChilds(node);
+		//Same rule as split, the element stays here if it fits into no child
+		size_t counts[5] = {};
+		mBuildTargets.resize(end - begin);
+		for(size_t i = begin; i < end; i++) {
+			uint8_t target = 4;
+			for(uint8_t c = 0; c < 4; c++) {
+				if(isInside(childs + c, mBuildElements[i])) {
+					target = c;
+					break;
+				}
+			}
+			mBuildTargets[i - begin] = target;
+			counts[target]++;
+		}
 
-			lock_guard<mutex> _lock(mMutex);
-			for(int i = 0; i < 4; i++)
-			{
-				lock_guard<mutex> _lock(mChilds[i]->mMutex);
-				mElements.insert(mElements.end(), mChilds[i]->mElements.begin(), mChilds[i]->mElements.end());
-				delete mChilds[i];
-				mChilds[i] = NULL;
+		if(counts[4] == end - begin) {
+			//Nothing gets smaller, e.g. only big elements
+			freeBlock(childs);
+		} else {
+			//Stable scatter, the elements of the children in order and then the ones of this node
+			size_t offsets[5];
+			offsets[0] = begin;
+			for(uint32_t c = 1; c < 5; c++)
+				offsets[c] = offsets[c - 1] + counts[c - 1];
+			mSplitBuffer.resize(end - begin);
+			for(size_t i = begin; i < end; i++)
+				mSplitBuffer[offsets[mBuildTargets[i - begin]]++ - begin] = mBuildElements[i];
+			std::copy(mSplitBuffer.begin(), mSplitBuffer.end(), mBuildElements.begin() + begin);
+			mSplitBuffer.clear();
+
+			n.childs = childs;
+			size_t first = begin;
+			for(uint32_t c = 0; c < 4; c++) {
+				build(childs + c, first, first + counts[c], depth + 1);
+				first += counts[c];
 			}
-			for(QuadTreeNodePtr& e : mElements)
-				e->mRegion = this;
-			mIsLeaf = true;
-			printf("Done Combining %ld Elems: %ld\n", getChildCount(), getElementCount());
+			begin = first;
 		}
 	}
+	for(size_t i = begin; i < end; i++)
+		pushElement(node, mBuildElements[i]);
 }
 
-bool QuadTree::isInside(QuadTreeNodePtr a) const {
-	return a->getPosition().x >= mPosition.x && a->getPosition().x <= mPosition.x+mSize.x &&
-		   a->getPosition().y >= mPosition.y && a->getPosition().y <= mPosition.y+mSize.y &&
-		   min(mSize.x, mSize.y) >= a->getSize();
+void QuadTree::combine(uint32_t node) {
+	Node& n = getNode(node);
+	if(!n.isLeaf()) {
+		invalidateNeighbours(node);
+		for(uint32_t i = 0; i < 4; i++) {
+			Node& c = getNode(n.childs + i);
+			combine(n.childs + i);
+			n.elements.insert(n.elements.end(), c.elements.begin(), c.elements.end());
+		}
+		freeBlock(n.childs);
+		n.childs = NO_NODE;
+		for(size_t i = 0; i < n.elements.size(); i++) {
+			n.elements[i]->mProxy = node;
+			n.elements[i]->mNodeSlot = (uint32_t) i;
+		}
+	}
+}
+
+bool QuadTree::isInside(uint32_t node, QuadTreeNodePtr a) const {
+	const Node& n = getNode(node);
+	return a->getPosition().x >= n.position.x && a->getPosition().x <= n.position.x+n.size.x &&
+		   a->getPosition().y >= n.position.y && a->getPosition().y <= n.position.y+n.size.y &&
+		   (n.parent == NO_NODE || (mLooseness > 1 ? getMaxLooseSize(node) : min(n.size.x, n.size.y)) >= a->getSize());
+}
+
+double QuadTree::getDistance(uint32_t node, const Vector& position) const {
+	const Node& n = getNode(node);
+	double dx = max(max(n.position.x - position.x, position.x - n.position.x - n.size.x), 0.);
+	double dy = max(max(n.position.y - position.y, position.y - n.position.y - n.size.y), 0.);
+	return dx * dx + dy * dy;
+}
+
+size_t QuadTree::nearestK(const Vector& position, size_t k, uint32_t types, Nearest* result) {
+	size_t count = 0;
+	mTraversals++;
+	if(k > 0)
+		nearestK(ROOT, position, k, types, result, count);
+	endTraversal();
+	return count;
 }
 
-bool QuadTree::intersects(QuadTreeNodePtr a) const {
-	return  a->getPosition().x+a->getSize() >= mPosition.x && a->getPosition().x-a->getSize() <= mPosition.x+mSize.x &&
-			a->getPosition().y+a->getSize() >= mPosition.y && a->getPosition().y-a->getSize() <= mPosition.y+mSize.y;
+void QuadTree::nearestK(uint32_t node, const Vector& position, size_t k, uint32_t types, Nearest* result, size_t& count) {
+	const Node& n = getNode(node);
+	//Can not contain anything nearer than the k found so far
+	if(!n.count || (count == k && getDistance(node, position) >= result[k - 1].distance))
+		return;
+	for(QuadTreeNodePtr e : n.elements) {
+		if((types & (1u << e->getCollisionType())) && !e->isDeleted())
+			insertNearest(result, count, k, e, e->getPosition().distanceSquared(position));
+	}
+	if(!n.isLeaf()) {
+		//Nearest children first, so the others can be skipped more often
+		uint32_t order[4] = {n.childs + 0, n.childs + 1, n.childs + 2, n.childs + 3};
+		double distances[4];
+		for(uint32_t i = 0; i < 4; i++)
+			distances[i] = getDistance(order[i], position);
+		for(uint32_t i = 1; i < 4; i++)
+			for(uint32_t j = i; j > 0 && distances[j - 1] > distances[j]; j--) {
+				std::swap(distances[j - 1], distances[j]);
+				std::swap(order[j - 1], order[j]);
+			}
+		for(uint32_t i = 0; i < 4; i++)
+			nearestK(order[i], position, k, types, result, count);
+	}
 }
 
+bool QuadTree::intersects(uint32_t node, QuadTreeNodePtr a, double size) const {
+	const Node& n = getNode(node);
+	return  a->getPosition().x+size >= n.position.x && a->getPosition().x-size <= n.position.x+n.size.x &&
+			a->getPosition().y+size >= n.position.y && a->getPosition().y-size <= n.position.y+n.size.y;
+}
 
-QuadTreePtr QuadTree::findNorth() const {
-	if (mParent) //it is not the head of the tree
+
+uint32_t QuadTree::findNorth(uint32_t node) const {
+	uint32_t parent = getNode(node).parent;
+	if (parent != NO_NODE) //it is not the head of the tree
 	{
-		if (this == mParent->mChilds[SE]) return mParent->mChilds[NE];
-		if (this == mParent->mChilds[SW]) return mParent->mChilds[NW];
-		QuadTreePtr n = mParent->findNorth();
-		if(n) {
-			if (n->mIsLeaf) return n;
-			else if (this == mParent->mChilds[NE]) return n->mChilds[SE];
-			else return n->mChilds[SW];
+		uint32_t siblings = getNode(parent).childs;
+		if (node == siblings + SE) return siblings + NE;
+		if (node == siblings + SW) return siblings + NW;
+		uint32_t n = findNorth(parent);
+		if(n != NO_NODE) {
+			if (getNode(n).isLeaf()) return n;
+			else if (node == siblings + NE) return getNode(n).childs + SE;
+			else return getNode(n).childs + SW;
 		}
 	}
-	return QuadTreePtr();
+	return NO_NODE;
 }
 
-QuadTreePtr QuadTree::findSouth() const {
-	if (mParent) //it is not the head of the tree
+uint32_t QuadTree::findSouth(uint32_t node) const {
+	uint32_t parent = getNode(node).parent;
+	if (parent != NO_NODE) //it is not the head of the tree
 	{
-		if (this == mParent->mChilds[NE]) return mParent->mChilds[SE];
-		if (this == mParent->mChilds[NW]) return mParent->mChilds[SW];
-		QuadTreePtr n = mParent->findSouth();
-		if(n) {
-			if (n->mIsLeaf) return n;
-			else if (this == mParent->mChilds[SE]) return n->mChilds[NE];
-			else return n->mChilds[NW];
+		uint32_t siblings = getNode(parent).childs;
+		if (node == siblings + NE) return siblings + SE;
+		if (node == siblings + NW) return siblings + SW;
+		uint32_t n = findSouth(parent);
+		if(n != NO_NODE) {
+			if (getNode(n).isLeaf()) return n;
+			else if (node == siblings + SE) return getNode(n).childs + NE;
+			else return getNode(n).childs + NW;
 		}
 	}
-	return QuadTreePtr();
+	return NO_NODE;
 }
 
-QuadTreePtr QuadTree::findEast() const {
-	if (mParent) //it is not the head of the tree
+uint32_t QuadTree::findEast(uint32_t node) const {
+	uint32_t parent = getNode(node).parent;
+	if (parent != NO_NODE) //it is not the head of the tree
 	{
-		if (this == mParent->mChilds[NW]) return mParent->mChilds[NE];
-		if (this == mParent->mChilds[SW]) return mParent->mChilds[SE];
-		QuadTreePtr n = mParent->findEast();
-		if(n) {
-			if (n->mIsLeaf) return n;
-			else if (this == mParent->mChilds[NE]) return n->mChilds[NW];
-			else return n->mChilds[SW];
+		uint32_t siblings = getNode(parent).childs;
+		if (node == siblings + NW) return siblings + NE;
+		if (node == siblings + SW) return siblings + SE;
+		uint32_t n = findEast(parent);
+		if(n != NO_NODE) {
+			if (getNode(n).isLeaf()) return n;
+			else if (node == siblings + NE) return getNode(n).childs + NW;
+			else return getNode(n).childs + SW;
 		}
 	}
-	return QuadTreePtr();
+	return NO_NODE;
 }
 
-QuadTreePtr QuadTree::findWest() const {
-	if (mParent) //it is not the head of the tree
+uint32_t QuadTree::findWest(uint32_t node) const {
+	uint32_t parent = getNode(node).parent;
+	if (parent != NO_NODE) //it is not the head of the tree
 	{
-		if (this == mParent->mChilds[NE]) return mParent->mChilds[NW];
-		if (this == mParent->mChilds[SE]) return mParent->mChilds[SW];
-		QuadTreePtr n = mParent->findWest();
-		if(n) {
-			if (n->mIsLeaf) return n;
-			else if (this == mParent->mChilds[NW]) return n->mChilds[NE];
-			else return n->mChilds[SE];
+		uint32_t siblings = getNode(parent).childs;
+		if (node == siblings + NE) return siblings + NW;
+		if (node == siblings + SE) return siblings + SW;
+		uint32_t n = findWest(parent);
+		if(n != NO_NODE) {
+			if (getNode(n).isLeaf()) return n;
+			else if (node == siblings + NW) return getNode(n).childs + NE;
+			else return getNode(n).childs + SE;
 		}
 	}
-	return QuadTreePtr();
+	return NO_NODE;
 }
 
-list<QuadTreePtr> QuadTree::getNeighbours() const {
-	if (!mParent) //head as no neigbours
-		return list<QuadTreePtr>();
+uint8_t QuadTree::findNeighbours(uint32_t node, uint32_t* neighbours) const {
+	if (getNode(node).parent == NO_NODE) //head as no neigbours
+		return 0;
+
+	uint32_t north = findNorth(node);
+	uint32_t west = findWest(node);
+	uint32_t south = findSouth(node);
+	uint32_t east = findEast(node);
+
+	uint8_t count = 0;
+
+	if(west != NO_NODE)
+		neighbours[count++] = west;
+	if(east != NO_NODE)
+		neighbours[count++] = east;
+	if(north != NO_NODE)
+		neighbours[count++] = north;
+	if(south != NO_NODE)
+		neighbours[count++] = south;
+
+	if(north != NO_NODE) {
+		uint32_t northeast = findEast(north);
+		if(northeast != NO_NODE)
+			neighbours[count++] = northeast;
+		uint32_t northwest = findWest(north);
+		if(northwest != NO_NODE)
+			neighbours[count++] = northwest;
+	}
 
-	QuadTreePtr northeast;
-	QuadTreePtr northwest;
-	QuadTreePtr southeast;
-	QuadTreePtr southwest;
-	QuadTreePtr north = findNorth();
-	QuadTreePtr west = findWest();
-	QuadTreePtr south = findSouth();
-	QuadTreePtr east = findEast();
+	if(south != NO_NODE) {
+		uint32_t southeast = findEast(south);
+		if(southeast != NO_NODE)
+			neighbours[count++] = southeast;
+		uint32_t southwest = findWest(south);
+		if(southwest != NO_NODE)
+			neighbours[count++] = southwest;
+	}
 
-	list<QuadTreePtr> res;
+	return count;
+}
 
-	if(west)
-		res.push_back(west);
-	if(east)
-		res.push_back(east);
-	if(north)
-		res.push_back(north);
-	if(south)
-		res.push_back(south);
+void QuadTree::invalidateNeighbours(uint32_t node) {
+	//Only nodes inside this one or inside one of its neighbours can find it or its children.
+	//The neighbours of the node itself do not change, they are on the same level or above
+	uint32_t neighbours[8];
+	uint8_t count = findNeighbours(node, neighbours);
+	invalidateSubtree(node);
+	for(uint8_t k = 0; k < count; k++)
+		invalidateSubtree(neighbours[k]);
+}
+
+void QuadTree::invalidateSubtree(uint32_t node) {
+	Node& n = getNode(node);
+	n.neighbourCount = NO_NEIGHBOURS;
+	if(!n.isLeaf())
+		for(uint32_t i = 0; i < 4; i++)
+			invalidateSubtree(n.childs + i);
+}
 
-	if(north) {
-		northeast = north->findEast();
-		if(northeast)
-			res.push_back(northeast);
-		northwest = north->findWest();
-		if(northwest)
-			res.push_back(northwest);
+bool QuadTree::validate() const {
+	size_t nodes = 0;
+	if(!validate(ROOT, nodes))
+		return false;
+	if(nodes != mUsedNodes) {
+		printf("QuadTree has %lu nodes but %u are used\n", nodes, mUsedNodes);
+		return false;
 	}
+	return true;
+}
 
-	if(south) {
-		southeast = south->findEast();
-		if(southeast)
-			res.push_back(southeast);
-		southwest = south->findWest();
-		if(southwest)
-			res.push_back(southwest);
+bool QuadTree::validate(uint32_t node, size_t& nodes) const {
+	const Node& n = getNode(node);
+	nodes++;
+	for(size_t i = 0; i < n.elements.size(); i++) {
+		QuadTreeNodePtr e = n.elements[i];
+		if(e->mBroadphase != this || e->mProxy != node || e->mNodeSlot != i) {
+			printf("Element %lu of node %u points to node %u slot %u\n", i, node, e->mProxy, e->mNodeSlot);
+			return false;
+		}
 	}
+	if(n.neighbourCount != NO_NEIGHBOURS) {
+		uint32_t neighbours[8];
+		uint8_t count = findNeighbours(node, neighbours);
+		if(count != n.neighbourCount || !std::equal(neighbours, neighbours + count, n.neighbours)) {
+			printf("Cached neighbours of node %u are stale\n", node);
+			return false;
+		}
+	}
+	size_t count = n.elements.size();
+	if(!n.isLeaf()) {
+		for(uint32_t i = 0; i < 4; i++) {
+			if(getNode(n.childs + i).parent != node) {
+				printf("Child %u of node %u has the parent %u\n", n.childs + i, node, getNode(n.childs + i).parent);
+				return false;
+			}
+			if(!validate(n.childs + i, nodes))
+				return false;
+			count += getNode(n.childs + i).count;
+		}
+	}
+	if(count != n.count) {
+		printf("Node %u holds %lu elements but counts %u\n", node, count, n.count);
+		return false;
+	}
+	return true;
+}
 
-	return res;
+bool QuadTreeNode::sweptIntersect(QuadTreeNodePtr other) const {
+	//Movement relative to the other element, which stays at the origin
+	Vector start = (mPosition - mSweep) - (other->mPosition - other->mSweep);
+	Vector move = mSweep - other->mSweep;
+	double len = move.lengthSquared();
+	//Closest point of the movement
+	double t = len > 0 ? min(max(-(start.x * move.x + start.y * move.y) / len, 0.), 1.) : 1.;
+	double dist = (start + move * t).lengthSquared();
+	double size = max(mSize, other->mSize);
+	return dist <= size * size;
 }
 
 void QuadTreeNode::updateRegion() {
-	if(!mRegion) {
-		printf("Element is not in a Region\n");
+	if(!mBroadphase) {
+		printf("Element is not in a Broadphase\n");
 		return;
 	}
-	if(!mRegion->isInside(this)) {
-		/* //Does not work because the element may skip regions in a lag
-		list<QuadTreePtr> regions = mRegion->getNeighbours();
-		for (QuadTreePtr region : regions) {
-			if (region->add(this))
-				return;
-		}*/
-		if(!mRegion->getHead()->add(this)) {
-			//Should never appear
-			fprintf(stderr, "Can not find Region for position %.0lf, %.0lf\n", mPosition.x, mPosition.y);
-			assert(false);
-		}
-	}
+	mBroadphase->update(this);
 }
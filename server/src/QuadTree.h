@@ -7,40 +7,9 @@
 
 #include "GlobalDefs.h"
 #include "Vector.h"
+#include "Broadphase.h"
 
-class QuadTreeNode : public std::enable_shared_from_this<QuadTreeNode> {
-friend class QuadTree;
-protected:
-	Vector mPosition;
-	double mSize = 0;
-
-private:
-	QuadTree* mRegion = NULL;
-	volatile bool mDeleted = false;
-
-public:
-	QuadTreeNode() {}
-	QuadTreeNode(const Vector& mPosition, double mSize) : mPosition(mPosition), mSize(mSize) { }
-
-	virtual ~QuadTreeNode() {}
-
-	const Vector& getPosition() const { return mPosition; }
-	double getSize() const { return mSize; }
-	QuadTreePtr getRegion() const { return mRegion; }
-	void setRegion(QuadTreePtr r)  { mRegion = r; }
-
-	inline bool intersect(QuadTreeNodePtr other) {
-		double dist = getPosition().distanceSquared(other->getPosition());
-		return dist <= getSize() * getSize() || dist <= other->getSize() * other->getSize();
-	}
-	void updateRegion();
-
-	bool isDeleted() const { return mDeleted; }
-	void markDeleted() { mDeleted = true; }
-};
-
-
-class QuadTree : public std::enable_shared_from_this<QuadTree> {
+class QuadTree : public Broadphase {
 friend class QuadTreeNode;
 private:
 	enum {
@@ -49,44 +18,229 @@ private:
 		SW,
 		SE
 	};
+	static const uint32_t NO_NODE = (uint32_t) -1;
+	//Added but not inserted yet
+	static const uint32_t PENDING = NO_NODE - 1;
+	static const uint32_t ROOT = 0;
+	//Nodes are allocated in chunks, so they never move and stay close to their siblings
+	static const uint32_t CHUNK_BITS = 8;
+	static const uint32_t CHUNK_SIZE = 1 << CHUNK_BITS;
+	//Neighbours of a node are not known yet
+	static const uint8_t NO_NEIGHBOURS = 0xFF;
+
+	struct Node {
+		Vector position;
+		Vector size;
+		uint32_t parent = NO_NODE;
+		//The four children are stored next to each other, NO_NODE for leafs
+		uint32_t childs = NO_NODE;
+		//Biggest element in this subtree, the loose bounds are expanded by it
+		double maxSize = 0;
+		//Start of the elements in the packed arrays
+		uint32_t packed = 0;
+		//Collision types of all elements in this subtree
+		uint32_t types = 0;
+		//Elements in this node and all its children
+		uint32_t count = 0;
+		//Already queued for restructuring
+		bool dirty = false;
+		//Cached result of findNeighbours, reset when a node next to it is split or combined
+		uint8_t neighbourCount = NO_NEIGHBOURS;
+		uint32_t neighbours[8];
+		vector<QuadTreeNodePtr> elements;
+
+		bool isLeaf() const { return childs == NO_NODE; }
+	};
+
 private:
-	QuadTreePtr mParent = NULL;
-	Vector mPosition;
-	Vector mSize;
-	size_t mMaxAmount;
+	//Leafs are split when they hold more than mSplitAmount elements and subtrees
+	//are combined when they hold at most mCombineAmount, the gap keeps them from flapping
+	size_t mSplitAmount;
+	size_t mCombineAmount;
+	//Elements up to (mLooseness - 1) / 2 of the node size may be placed by their center (1 = classic quadtree)
+	double mLooseness;
+	//Build the tree from all elements with every check instead of updating it, see build
+	bool mRebuild = false;
+	//Nodes are not split any further at this depth, e.g. for many elements at the same position
+	static const uint32_t MAX_DEPTH = 24;
+
+	vector<unique_ptr<Node[]> > mChunks;
+	uint32_t mNodeCount = 0;
+	uint32_t mUsedNodes = 0;
+	vector<uint32_t> mFreeBlocks;
+	//Nodes that changed since the last check, they are split or combined once per tick
+	vector<uint32_t> mDirty;
+	vector<QuadTreeNodePtr> mSplitBuffer;
+	//All elements while the tree is built and the child each one goes to
+	vector<QuadTreeNodePtr> mBuildElements;
+	vector<uint8_t> mBuildTargets;
+
+	//Subtrees with at most TASK_SIZE elements are checked by one task
+	static const uint32_t TASK_SIZE = 256;
+	struct Task {
+		uint32_t node;
+		bool subtree;
+	};
+	vector<Task> mTasks;
+
+	//Positions and sizes of all elements in the order of the nodes, filled before every check
+	vector<double> mPackedX;
+	vector<double> mPackedY;
+	vector<double> mPackedSize;
+
+	/*
+	 * The tree is only changed on the simulation thread and never while it is read, so the
+	 * checks and queries read the node arrays in place without any lock:
+	 * - Elements may be added from any thread, they are inserted at the start of the next check.
+	 * - Elements removed or moved by a query visitor are changed after the query.
+	 */
+	vector<QuadTreeNodePtr> mPending;
+	vector<QuadTreeNodePtr> mInserting;
+	mutex mPendingMutex;
+	uint32_t mTraversals = 0;
+	struct Deferred {
+		QuadTreeNodePtr elem;
+		bool remove;
+	};
+	vector<Deferred> mDeferred;
 
-	std::function<void (QuadTreeNodePtr, QuadTreeNodePtr)> mCollisionCallback;
-	vector<QuadTreeNodePtr> mElements;
-	QuadTreePtr mChilds[4];
-	volatile bool mIsLeaf = true;
+public:
+	QuadTree(const Vector& mPosition, const Vector& mSize, size_t mSplitAmount = 5, size_t mCombineAmount = 2, double mLooseness = 1);
 
-	mutex mMutex;
+	virtual bool add(QuadTreeNodePtr elem);
+	virtual bool remove(QuadTreeNodePtr elem);
+	virtual void update(QuadTreeNodePtr elem);
 
-public:
-	QuadTree(const Vector& mPosition, const Vector& mSize, std::function<void (QuadTreeNodePtr, QuadTreeNodePtr)> mCollisionCallback, size_t mMaxAmount = 5, QuadTreePtr mParent = NULL);
+	virtual size_t getElementCount() const { return getNode(ROOT).count; }
+	virtual size_t getChildCount() const { return mUsedNodes; }
 
-	void doCollisionCheck();
-	bool add(QuadTreeNodePtr elem);
-	bool remove(QuadTreeNodePtr elem);
+	virtual const char* getName() const {
+		if(mRebuild)
+			return mLooseness > 1 ? "loosequadtree (rebuild)" : "quadtree (rebuild)";
+		return mLooseness > 1 ? "loosequadtree" : "quadtree";
+	}
 
-	size_t getElementCount() const;
-	size_t getChildCount() const;
-private:
+	//Moved elements are not relocated and nodes are not split or combined, instead the
+	//whole tree is built again at the start of every check. Cheaper if a lot of elements move
+	void setRebuild(bool rebuild) { mRebuild = rebuild; }
+
+	/*
+	 * The queries of Broadphase walk the tree, nothing is allocated. The templates are used
+	 * for lambdas, so the visitor is inlined, the virtual ones for calls through Broadphase.
+	 */
+	template<typename Visitor>
+	void queryRect(const Vector& from, const Vector& to, uint32_t types, Visitor&& visitor) {
+		mTraversals++;
+		queryRect(ROOT, from, to, types, visitor);
+		endTraversal();
+	}
+	virtual void queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor) {
+		mTraversals++;
+		queryRect(ROOT, from, to, types, visitor);
+		endTraversal();
+	}
+	template<typename Visitor>
+	void queryCircle(const Vector& center, double radius, uint32_t types, Visitor&& visitor) {
+		mTraversals++;
+		queryCircle(ROOT, center, radius * radius, types, visitor);
+		endTraversal();
+	}
+	virtual void queryCircle(const Vector& center, double radius, uint32_t types, QueryVisitor visitor) {
+		mTraversals++;
+		queryCircle(ROOT, center, radius * radius, types, visitor);
+		endTraversal();
+	}
+	virtual size_t nearestK(const Vector& position, size_t k, uint32_t types, Nearest* result);
 
-	QuadTreePtr getHead() { return mParent ? mParent->getHead() : this; }
+	//Checks the parents, counts, element slots and cached neighbours of all nodes and prints the first
+	//mismatch. Walks the whole tree, only for checks like the tree fuzzer
+	bool validate() const;
 
-	void checkCollision(QuadTreeNodePtr elem);
-	void split();
-	void combine();
+protected:
+	virtual void findCollisions();
 
-	bool isInside(QuadTreeNodePtr elem) const;
-	bool intersects(QuadTreeNodePtr elem) const;
+private:
+	Node& getNode(uint32_t node) { return mChunks[node >> CHUNK_BITS][node & (CHUNK_SIZE - 1)]; }
+	const Node& getNode(uint32_t node) const { return mChunks[node >> CHUNK_BITS][node & (CHUNK_SIZE - 1)]; }
+	uint32_t allocateBlock();
+	void freeBlock(uint32_t first);
+
+	void insertPending();
+	//Applies the changes deferred during the last query
+	void endTraversal();
+	bool insert(uint32_t node, QuadTreeNodePtr elem);
+	bool erase(uint32_t node, QuadTreeNodePtr elem);
+	//Appends the element to the node and stores its slot
+	void pushElement(uint32_t node, QuadTreeNodePtr elem);
+	void addCount(uint32_t node, int32_t amount);
+	void markDirty(uint32_t node);
+	void restructure();
+	//Moves all elements to mBuildElements and frees all nodes below the root
+	void collectElements(uint32_t node);
+	//Partitions mBuildElements[begin, end) between the node and its children
+	void build(uint32_t node, size_t begin, size_t end, uint32_t depth);
+	//Allocates the children of a leaf and returns the first one
+	uint32_t createChilds(uint32_t node);
+
+	void collectTasks(uint32_t node);
+	void checkSubtree(uint32_t node, TaskResult& result);
+	void checkNode(uint32_t node, TaskResult& result);
+	void doCollisionCheck(uint32_t node, TaskResult& result);
+	void checkCollision(uint32_t node, QuadTreeNodePtr elem, TaskResult& result);
+	double updatePacked(uint32_t node);
+	void testElements(uint32_t node, size_t begin, QuadTreeNodePtr elem, bool ordered, TaskResult& result);
+	void doLooseCollisionCheck(uint32_t node, TaskResult& result);
+	void checkLooseCollision(uint32_t node, QuadTreeNodePtr elem, bool ordered, TaskResult& result);
+	void split(uint32_t node);
+	void combine(uint32_t node);
+
+	double getMaxLooseSize(uint32_t node) const { return min(getNode(node).size.x, getNode(node).size.y) * (mLooseness - 1) / 2; }
+	bool isInside(uint32_t node, QuadTreeNodePtr elem) const;
+	bool intersects(uint32_t node, QuadTreeNodePtr elem, double size) const;
+
+	//Squared distance from the position to the area of the node, 0 if it is inside
+	double getDistance(uint32_t node, const Vector& position) const;
+	void nearestK(uint32_t node, const Vector& position, size_t k, uint32_t types, Nearest* result, size_t& count);
+
+	static bool matchesCircle(QuadTreeNodePtr e, const Vector& center, double radiusSquared, uint32_t types) {
+		return (types & (1u << e->getCollisionType())) && !e->isDeleted() && e->getPosition().distanceSquared(center) <= radiusSquared;
+	}
+	template<typename Visitor>
+	void queryRect(uint32_t node, const Vector& from, const Vector& to, uint32_t types, Visitor& visitor) {
+		const Node& n = getNode(node);
+		if(!n.count || n.position.x > to.x || n.position.x + n.size.x < from.x || n.position.y > to.y || n.position.y + n.size.y < from.y)
+			return;
+		for(QuadTreeNodePtr e : n.elements)
+			if(matches(e, from, to, types))
+				visitor(e);
+		if(!n.isLeaf())
+			for(uint32_t i = 0; i < 4; i++)
+				queryRect(n.childs + i, from, to, types, visitor);
+	}
+	template<typename Visitor>
+	void queryCircle(uint32_t node, const Vector& center, double radius, uint32_t types, Visitor& visitor) {
+		const Node& n = getNode(node);
+		if(!n.count || getDistance(node, center) > radius)
+			return;
+		for(QuadTreeNodePtr e : n.elements)
+			if(matchesCircle(e, center, radius, types))
+				visitor(e);
+		if(!n.isLeaf())
+			for(uint32_t i = 0; i < 4; i++)
+				queryCircle(n.childs + i, center, radius, types, visitor);
+	}
 
-	QuadTreePtr findNorth() const;
-	QuadTreePtr findSouth() const;
-	QuadTreePtr findEast() const;
-	QuadTreePtr findWest() const;
-	list<QuadTreePtr> getNeighbours() const;
+	uint32_t findNorth(uint32_t node) const;
+	uint32_t findSouth(uint32_t node) const;
+	uint32_t findEast(uint32_t node) const;
+	uint32_t findWest(uint32_t node) const;
+	//Fills neighbours with up to 8 nodes around this one and returns their number
+	uint8_t findNeighbours(uint32_t node, uint32_t* neighbours) const;
+	//Resets the cached neighbours that may point to this node or its children
+	void invalidateNeighbours(uint32_t node);
+	void invalidateSubtree(uint32_t node);
+
+	bool validate(uint32_t node, size_t& nodes) const;
 
 };
 
@@ -0,0 +1,74 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_QUADTREENODE_H
+#define SERVER_QUADTREENODE_H
+
+#include "GlobalDefs.h"
+#include "Vector.h"
+
+//Number of collision types (see QuadTreeNode::setCollisionType) with their own pair counters
+static const uint32_t COLLISION_TYPES = 8;
+
+/*
+ * Element of the broadphases. Each one is in at most one Broadphase, which keeps its own position
+ * of the element in mProxy.
+ */
+class QuadTreeNode : public std::enable_shared_from_this<QuadTreeNode> {
+friend class QuadTree;
+friend class SpatialHash;
+friend class SweepAndPrune;
+friend class StaticIndex;
+friend class LinearQuadTree;
+friend class AABBTree;
+protected:
+	Vector mPosition;
+	double mSize = 0;
+	//Movement in the last tick if it was further than the own size, see SweepIndex
+	Vector mSweep;
+
+private:
+	BroadphasePtr mBroadphase = NULL;
+	//Broadphase specific position of this element (QuadTree node or index)
+	uint32_t mProxy = 0;
+	//Index in the elements of the QuadTree node, so it is removed without a search
+	uint32_t mNodeSlot = 0;
+	//Pairs are only reported if the type of one element is in the mask of the other one
+	uint8_t mCollisionType = 0;
+	uint32_t mCollisionMask = ~0u;
+	volatile bool mDeleted = false;
+
+public:
+	QuadTreeNode() {}
+	QuadTreeNode(const Vector& mPosition, double mSize) : mPosition(mPosition), mSize(mSize) { }
+
+	virtual ~QuadTreeNode() {}
+
+	const Vector& getPosition() const { return mPosition; }
+	double getSize() const { return mSize; }
+	BroadphasePtr getBroadphase() const { return mBroadphase; }
+
+	void setCollisionType(uint8_t type, uint32_t mask) { assert(type < COLLISION_TYPES); mCollisionType = type; mCollisionMask = mask; }
+	uint8_t getCollisionType() const { return mCollisionType; }
+	uint32_t getCollisionMask() const { return mCollisionMask; }
+	bool canCollide(QuadTreeNodePtr other) const { return (mCollisionMask & (1u << other->mCollisionType)) != 0; }
+
+	inline bool intersect(QuadTreeNodePtr other) {
+		double dist = getPosition().distanceSquared(other->getPosition());
+		return dist <= getSize() * getSize() || dist <= other->getSize() * other->getSize();
+	}
+	//Same rule as intersect, but for the movement of both elements in the last tick
+	bool sweptIntersect(QuadTreeNodePtr other) const;
+	void updateRegion();
+
+	void setSweep(const Vector& movement) { mSweep = movement.lengthSquared() > mSize * mSize ? movement : Vector(); }
+	const Vector& getSweep() const { return mSweep; }
+	bool isSwept() const { return mSweep.x != 0 || mSweep.y != 0; }
+
+	bool isDeleted() const { return mDeleted; }
+	void markDeleted() { mDeleted = true; }
+};
+
+
+#endif //SERVER_QUADTREENODE_H
@@ -5,9 +5,9 @@
 #include "Shoot.h"
 #include "Gamefield.h"
 
-Shoot::Shoot(GamefieldPtr mGamefield, uint32_t mId, const Vector& mPosition, const String& mColor,
+Shoot::Shoot(GamefieldPtr mGamefield, ElementHandle mHandle, const Vector& mPosition, uint16_t mColor,
 			 const Vector& direction) :
-		MoveableElement(mGamefield, mId, mPosition, mColor, mGamefield->getOptions().shoot.size,
+		MoveableElement(mGamefield, mHandle, ET_Shoot, mPosition, mColor, mGamefield->getOptions().shoot.size,
 						mGamefield->getOptions().shoot.mass) {
 	setBoost(direction * mGamefield->getOptions().shoot.speed, mGamefield->getOptions().shoot.acceleration);
 }
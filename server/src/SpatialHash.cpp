@@ -0,0 +1,128 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "SpatialHash.h"
+#include "QuadTree.h"
+
+SpatialHash::SpatialHash(const Vector& mSize, double mCellSize) :
+		mSize(mSize), mCellSize(mCellSize)
+{
+	mColumns = (uint32_t) max(1., ceil(mSize.x / mCellSize));
+	mRows = (uint32_t) max(1., ceil(mSize.y / mCellSize));
+	mCellStart.reserve(mColumns * mRows + 1);
+}
+
+void SpatialHash::findCollisions() {
+	rebuild();
+
+	//Rows share no pairs, so every row is a task
+	runTasks(mRows, [this] (size_t row, TaskResult& result) {
+		checkRow((uint32_t) row, result);
+	});
+}
+
+void SpatialHash::checkRow(uint32_t y, TaskResult& result) {
+	for(uint32_t x = 0; x < mColumns; x++) {
+		uint32_t cell = y * mColumns + x;
+		uint32_t end = mCellStart[cell + 1];
+		for(uint32_t i = mCellStart[cell]; i < end; i++) {
+			const CellEntry& e1 = mCellElements[i];
+			if(e1.elem->isDeleted()) continue;
+			for(uint32_t j = i + 1; j < end; j++) {
+				const CellEntry& e2 = mCellElements[j];
+				//Big elements share more than one cell, only check them in the first one
+				if(max(e1.minX, e2.minX) != x || max(e1.minY, e2.minY) != y) continue;
+				if(e1.elem->isDeleted() || e2.elem->isDeleted()) continue;
+				if(!e1.elem->canCollide(e2.elem)) {
+					result.drop(e1.elem->getCollisionType(), e2.elem->getCollisionType());
+					continue;
+				}
+				result.pairTests++;
+				if(e1.elem->intersect(e2.elem)) {
+					result.pairs.push_back(CollisionPair {e1.elem, e2.elem});
+				}
+			}
+		}
+	}
+}
+
+bool SpatialHash::add(QuadTreeNodePtr elem) {
+	lock_guard<mutex> _lock(mMutex);
+	elem->mBroadphase = this;
+	elem->mProxy = (uint32_t) mElements.size();
+	mElements.push_back(elem);
+	return true;
+}
+
+bool SpatialHash::remove(QuadTreeNodePtr elem) {
+	lock_guard<mutex> _lock(mMutex);
+	if(elem->mBroadphase != this || elem->mProxy >= mElements.size() || mElements[elem->mProxy] != elem)
+		return false;
+	//Swap with last element then pop last
+	mElements[elem->mProxy] = mElements.back();
+	mElements[elem->mProxy]->mProxy = elem->mProxy;
+	mElements.pop_back();
+	elem->mBroadphase = NULL;
+	return true;
+}
+
+void SpatialHash::rebuild() {
+	lock_guard<mutex> _lock(mMutex);
+	uint32_t cells = mColumns * mRows;
+
+	//Count elements per cell
+	mRanges.resize(mElements.size());
+	mCellStart.assign(cells + 1, 0);
+	uint32_t total = 0;
+	for(size_t i = 0; i < mElements.size(); i++) {
+		CellRange& r = mRanges[i];
+		r = getRange(mElements[i]);
+		for(uint32_t y = r.minY; y <= r.maxY; y++)
+			for(uint32_t x = r.minX; x <= r.maxX; x++)
+				mCellStart[y * mColumns + x]++;
+		total += (r.maxX - r.minX + 1) * (r.maxY - r.minY + 1);
+	}
+	//mCellStart[c] is now the end of cell c
+	for(uint32_t c = 1; c < cells; c++)
+		mCellStart[c] += mCellStart[c - 1];
+	mCellStart[cells] = total;
+
+	//Fill backwards so mCellStart[c] ends up at the start of cell c
+	mCellElements.resize(total);
+	for(size_t i = 0; i < mElements.size(); i++) {
+		const CellRange& r = mRanges[i];
+		for(uint32_t y = r.minY; y <= r.maxY; y++)
+			for(uint32_t x = r.minX; x <= r.maxX; x++)
+				mCellElements[--mCellStart[y * mColumns + x]] = CellEntry {mElements[i], r.minX, r.minY};
+	}
+}
+
+SpatialHash::CellRange SpatialHash::getRange(QuadTreeNodePtr elem) const {
+	const Vector& pos = elem->getPosition();
+	double size = elem->getSize();
+	return CellRange {
+			toCell(pos.x - size, mColumns),
+			toCell(pos.y - size, mRows),
+			toCell(pos.x + size, mColumns),
+			toCell(pos.y + size, mRows)
+	};
+}
+
+uint32_t SpatialHash::toCell(double pos, uint32_t count) const {
+	if(pos <= 0)
+		return 0;
+	return min((uint32_t) (pos / mCellSize), count - 1);
+}
+
+void SpatialHash::queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor) {
+	size_t begin = mFound.size();
+	{
+		lock_guard<mutex> _lock(mMutex);
+		for(QuadTreeNodePtr elem : mElements)
+			if(matches(elem, from, to, types))
+				mFound.push_back(elem);
+	}
+	//After unlocking, the visitor may add elements
+	visitFound(begin, visitor);
+}
@@ -0,0 +1,71 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_SPATIALHASH_H
+#define SERVER_SPATIALHASH_H
+
+#include "GlobalDefs.h"
+#include "Vector.h"
+#include "Broadphase.h"
+
+/*
+ * Uniform grid over the gamefield. The cells are rebuilt once per collision check
+ * with a counting sort into reused arrays, so there is no allocation per frame.
+ * Elements bigger than a cell are inserted into every cell they overlap, a pair
+ * is only tested in the first cell both elements share.
+ */
+class SpatialHash : public Broadphase {
+private:
+	struct CellEntry {
+		QuadTreeNodePtr elem;
+		uint32_t minX;
+		uint32_t minY;
+	};
+	struct CellRange {
+		uint32_t minX;
+		uint32_t minY;
+		uint32_t maxX;
+		uint32_t maxY;
+	};
+
+	Vector mSize;
+	double mCellSize;
+	uint32_t mColumns;
+	uint32_t mRows;
+
+	vector<QuadTreeNodePtr> mElements;
+
+	vector<CellRange> mRanges;
+	vector<uint32_t> mCellStart;
+	vector<CellEntry> mCellElements;
+
+	mutex mMutex;
+
+public:
+	SpatialHash(const Vector& mSize, double mCellSize);
+
+	virtual bool add(QuadTreeNodePtr elem);
+	virtual bool remove(QuadTreeNodePtr elem);
+	virtual void update(QuadTreeNodePtr elem) {} //Cells are rebuilt on every check
+
+	virtual size_t getElementCount() const { return mElements.size(); }
+	virtual size_t getChildCount() const { return mColumns * mRows; }
+
+	virtual const char* getName() const { return "spatialhash"; }
+
+	//Scans all elements, the cells are only valid during a check
+	virtual void queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor);
+
+protected:
+	virtual void findCollisions();
+
+private:
+	void rebuild();
+	void checkRow(uint32_t y, TaskResult& result);
+	CellRange getRange(QuadTreeNodePtr elem) const;
+	uint32_t toCell(double pos, uint32_t count) const;
+};
+
+
+#endif //SERVER_SPATIALHASH_H
@@ -0,0 +1,159 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "StaticIndex.h"
+#include "QuadTree.h"
+#include "PackedIntersect.h"
+
+StaticIndex::StaticIndex(const Vector& mSize, double mCellSize) :
+		mSize(mSize), mCellSize(mCellSize)
+{
+	mColumns = (uint32_t) max(1., ceil(mSize.x / mCellSize));
+	mRows = (uint32_t) max(1., ceil(mSize.y / mCellSize));
+	mCells.resize(mColumns * mRows);
+}
+
+bool StaticIndex::add(QuadTreeNodePtr elem) {
+	lock_guard<mutex> _lock(mMutex);
+	Cell& cell = mCells[getCell(elem->getPosition())];
+	elem->mBroadphase = this;
+	elem->mProxy = (uint32_t) cell.elements.size();
+	cell.elements.push_back(elem);
+	cell.xs.push_back(elem->getPosition().x);
+	cell.ys.push_back(elem->getPosition().y);
+	cell.sizes.push_back(elem->getSize());
+	mMaxSize = max(mMaxSize, elem->getSize());
+	mTypes |= 1u << elem->getCollisionType();
+	mElementCount++;
+	return true;
+}
+
+bool StaticIndex::remove(QuadTreeNodePtr elem) {
+	lock_guard<mutex> _lock(mMutex);
+	Cell& cell = mCells[getCell(elem->getPosition())];
+	uint32_t slot = elem->mProxy;
+	if(elem->mBroadphase != this || slot >= cell.elements.size() || cell.elements[slot] != elem)
+		return false;
+	//Swap with last element then pop last
+	cell.elements[slot] = cell.elements.back();
+	cell.elements[slot]->mProxy = slot;
+	cell.xs[slot] = cell.xs.back();
+	cell.ys[slot] = cell.ys.back();
+	cell.sizes[slot] = cell.sizes.back();
+	cell.elements.pop_back();
+	cell.xs.pop_back();
+	cell.ys.pop_back();
+	cell.sizes.pop_back();
+	elem->mBroadphase = NULL;
+	mElementCount--;
+	return true;
+}
+
+void StaticIndex::findCollisions() {
+	if(!mMoving)
+		return;
+	lock_guard<mutex> _lock(mMutex);
+	const vector<QuadTreeNodePtr>& moving = *mMoving;
+	runTasks((moving.size() + TASK_SIZE - 1) / TASK_SIZE, [this, &moving] (size_t task, TaskResult& result) {
+		size_t end = min(moving.size(), (task + 1) * TASK_SIZE);
+		for(size_t i = task * TASK_SIZE; i < end; i++)
+			query(moving[i], result);
+	});
+}
+
+void StaticIndex::query(QuadTreeNodePtr elem, TaskResult& result) {
+	//e.g. Shoots can not interact with Food or Items at all
+	if(elem->isDeleted() || !(elem->getCollisionMask() & mTypes))
+		return;
+	const Vector& pos = elem->getPosition();
+	double size = elem->getSize();
+	//The center of the static element is inside elem or the other way round
+	double range = max(size, mMaxSize);
+	uint32_t minX = toCell(pos.x - range, mColumns), maxX = toCell(pos.x + range, mColumns);
+	uint32_t minY = toCell(pos.y - range, mRows), maxY = toCell(pos.y + range, mRows);
+	for(uint32_t y = minY; y <= maxY; y++) {
+		for(uint32_t x = minX; x <= maxX; x++) {
+			const Cell& cell = mCells[y * mColumns + x];
+			for(size_t i = 0; i < cell.elements.size(); i += PACKED_BATCH) {
+				size_t count = min(cell.elements.size() - i, (size_t) PACKED_BATCH);
+				uint64_t hits = intersectPacked(pos.x, pos.y, size, &cell.xs[i], &cell.ys[i], &cell.sizes[i], count);
+				result.pairTests += count;
+				for(; hits; hits &= hits - 1) {
+					QuadTreeNodePtr other = cell.elements[i + __builtin_ctzll(hits)];
+					if(other->isDeleted()) continue;
+					if(!elem->canCollide(other)) {
+						result.drop(elem->getCollisionType(), other->getCollisionType());
+						continue;
+					}
+					result.pairs.push_back(CollisionPair {elem, other});
+				}
+			}
+		}
+	}
+}
+
+void StaticIndex::queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor) {
+	size_t begin = mFound.size();
+	{
+		lock_guard<mutex> _lock(mMutex);
+		if(!(types & mTypes) || from.x > to.x || from.y > to.y)
+			return;
+		uint32_t minX = toCell(from.x, mColumns), maxX = toCell(to.x, mColumns);
+		uint32_t minY = toCell(from.y, mRows), maxY = toCell(to.y, mRows);
+		for(uint32_t y = minY; y <= maxY; y++) {
+			for(uint32_t x = minX; x <= maxX; x++) {
+				for(QuadTreeNodePtr elem : mCells[y * mColumns + x].elements)
+					if(matches(elem, from, to, types))
+						mFound.push_back(elem);
+			}
+		}
+	}
+	//After unlocking, the visitor may add or remove elements
+	visitFound(begin, visitor);
+}
+
+size_t StaticIndex::nearestK(const Vector& position, size_t k, uint32_t types, Nearest* result) {
+	lock_guard<mutex> _lock(mMutex);
+	size_t count = 0;
+	if(k == 0 || !(types & mTypes))
+		return 0;
+	//Rings of cells around the cell of the position, until no cell further out can be nearer
+	int64_t cellX = toCell(position.x, mColumns), cellY = toCell(position.y, mRows);
+	int64_t maxRing = max(max(cellX, mColumns - 1 - cellX), max(cellY, mRows - 1 - cellY));
+	for(int64_t ring = 0; ring <= maxRing; ring++) {
+		for(int64_t y = max(cellY - ring, (int64_t) 0); y <= min(cellY + ring, mRows - (int64_t) 1); y++) {
+			//Only the border of the ring, the inner cells were searched before
+			bool border = y == cellY - ring || y == cellY + ring;
+			for(int64_t x = cellX - ring; x <= cellX + ring; x += border || ring == 0 ? 1 : 2 * ring)
+				if(x >= 0 && x < mColumns)
+					nearestK((uint32_t) x, (uint32_t) y, position, k, types, result, count);
+		}
+		//Elements further out are more than ring cells away
+		double distance = ring * mCellSize;
+		if(count == k && distance * distance >= result[k - 1].distance)
+			break;
+	}
+	return count;
+}
+
+void StaticIndex::nearestK(uint32_t x, uint32_t y, const Vector& position, size_t k, uint32_t types, Nearest* result, size_t& count) const {
+	const Cell& cell = mCells[y * mColumns + x];
+	for(size_t i = 0; i < cell.elements.size(); i++) {
+		QuadTreeNodePtr elem = cell.elements[i];
+		if((types & (1u << elem->getCollisionType())) && !elem->isDeleted()) {
+			double dx = cell.xs[i] - position.x, dy = cell.ys[i] - position.y;
+			insertNearest(result, count, k, elem, dx * dx + dy * dy);
+		}
+	}
+}
+
+uint32_t StaticIndex::getCell(const Vector& pos) const {
+	return toCell(pos.y, mRows) * mColumns + toCell(pos.x, mColumns);
+}
+
+uint32_t StaticIndex::toCell(double pos, uint32_t count) const {
+	if(pos <= 0)
+		return 0;
+	return min((uint32_t) (pos / mCellSize), count - 1);
+}
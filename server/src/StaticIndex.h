@@ -0,0 +1,80 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_STATICINDEX_H
+#define SERVER_STATICINDEX_H
+
+#include "GlobalDefs.h"
+#include "Vector.h"
+#include "Broadphase.h"
+
+/*
+ * Grid for elements that never move (Food, Items). They are put into the cell of their center
+ * once, so there is nothing to rebuild. Static elements are never tested against each other,
+ * only the moving elements passed to doCollisionCheck are tested against the cells around them.
+ */
+class StaticIndex : public Broadphase {
+private:
+	struct Cell {
+		vector<QuadTreeNodePtr> elements;
+		//Packed copies for intersectPacked, static elements never change them
+		vector<double> xs;
+		vector<double> ys;
+		vector<double> sizes;
+	};
+	//Moving elements tested by one task
+	static const size_t TASK_SIZE = 64;
+
+	Vector mSize;
+	double mCellSize;
+	uint32_t mColumns;
+	uint32_t mRows;
+
+	vector<Cell> mCells;
+	size_t mElementCount = 0;
+	//Biggest static element, queries are expanded by it
+	double mMaxSize = 0;
+	//Collision types of all static elements ever added
+	uint32_t mTypes = 0;
+
+	const vector<QuadTreeNodePtr>* mMoving = NULL;
+
+	mutex mMutex;
+
+public:
+	StaticIndex(const Vector& mSize, double mCellSize);
+
+	virtual bool add(QuadTreeNodePtr elem);
+	virtual bool remove(QuadTreeNodePtr elem);
+	virtual void update(QuadTreeNodePtr elem) {} //Static elements do not move
+
+	//Tests the moving elements against all static ones
+	template<typename Visitor>
+	void doCollisionCheck(const vector<QuadTreeNodePtr>& moving, Visitor&& visitor) {
+		mMoving = &moving;
+		Broadphase::doCollisionCheck(visitor);
+		mMoving = NULL;
+	}
+
+	virtual size_t getElementCount() const { return mElementCount; }
+	virtual size_t getChildCount() const { return mCells.size(); }
+
+	virtual const char* getName() const { return "static"; }
+
+	//Only the cells that overlap the query are searched
+	virtual void queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor);
+	virtual size_t nearestK(const Vector& position, size_t k, uint32_t types, Nearest* result);
+
+protected:
+	virtual void findCollisions();
+
+private:
+	void query(QuadTreeNodePtr elem, TaskResult& result);
+	void nearestK(uint32_t x, uint32_t y, const Vector& position, size_t k, uint32_t types, Nearest* result, size_t& count) const;
+	uint32_t getCell(const Vector& pos) const;
+	uint32_t toCell(double pos, uint32_t count) const;
+};
+
+
+#endif //SERVER_STATICINDEX_H
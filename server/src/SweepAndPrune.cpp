@@ -0,0 +1,166 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "SweepAndPrune.h"
+#include "QuadTree.h"
+
+static const uint32_t NO_INDEX = (uint32_t) -1;
+
+SweepAndPrune::SweepAndPrune() {
+}
+
+void SweepAndPrune::findCollisions() {
+	{
+		lock_guard<mutex> _lock(mMutex);
+		compact();
+		size_t added = insertNew();
+		updateEndpoints();
+		//Insertion sort is slow for a lot of new unsorted elements (e.g. the initial food)
+		if(added * 16 > mEndpoints.size())
+			std::sort(mEndpoints.begin(), mEndpoints.end());
+		else
+			sort();
+	}
+
+	//The sweep depends on all endpoints before, so it is a single task
+	runTasks(1, [this] (size_t, TaskResult& result) {
+		sweep(result);
+	});
+}
+
+void SweepAndPrune::sweep(TaskResult& result) {
+	mActive.clear();
+	for(size_t i = 0; i < mEndpoints.size(); i++) {
+		const Endpoint& ep = mEndpoints[i];
+		Proxy& p1 = mProxies[ep.proxy];
+		if(!ep.isMin) {
+			//Swap with last active element then pop last
+			mActive[p1.active] = mActive.back();
+			mProxies[mActive[p1.active]].active = p1.active;
+			mActive.pop_back();
+			continue;
+		}
+
+		QuadTreeNodePtr e1 = p1.elem;
+		for(uint32_t a : mActive) {
+			QuadTreeNodePtr e2 = mProxies[a].elem;
+			if(e1->isDeleted() || e2->isDeleted()) continue;
+			if(!e1->canCollide(e2)) {
+				result.drop(e1->getCollisionType(), e2->getCollisionType());
+				continue;
+			}
+			//Already overlapping on the x axis, check y before the exact test
+			if(fabs(e1->getPosition().y - e2->getPosition().y) > e1->getSize() + e2->getSize()) continue;
+			result.pairTests++;
+			if(e1->intersect(e2)) {
+				result.pairs.push_back(CollisionPair {e1, e2});
+			}
+		}
+		p1.active = (uint32_t) mActive.size();
+		mActive.push_back(ep.proxy);
+	}
+}
+
+bool SweepAndPrune::add(QuadTreeNodePtr elem) {
+	lock_guard<mutex> _lock(mMutex);
+	elem->mBroadphase = this;
+	elem->mProxy = NO_INDEX;
+	mNewElements.push_back(elem);
+	return true;
+}
+
+bool SweepAndPrune::remove(QuadTreeNodePtr elem) {
+	lock_guard<mutex> _lock(mMutex);
+	if(elem->mBroadphase != this)
+		return false;
+	elem->mBroadphase = NULL;
+	if(elem->mProxy == NO_INDEX) { //Still queued
+		auto it = std::find(mNewElements.begin(), mNewElements.end(), elem);
+		if(it == mNewElements.end())
+			return false;
+		*it = mNewElements.back();
+		mNewElements.pop_back();
+		return true;
+	}
+	if(elem->mProxy >= mProxies.size() || mProxies[elem->mProxy].elem != elem)
+		return false;
+	//Endpoints are dropped on the next check
+	mProxies[elem->mProxy].elem = NULL;
+	mRemovedCount++;
+	return true;
+}
+
+void SweepAndPrune::compact() {
+	if(mRemovedCount == 0)
+		return;
+
+	mRemap.resize(mProxies.size());
+	uint32_t count = 0;
+	for(size_t i = 0; i < mProxies.size(); i++) {
+		if(mProxies[i].elem) {
+			mRemap[i] = count;
+			mProxies[count] = mProxies[i];
+			mProxies[count].elem->mProxy = count;
+			count++;
+		} else
+			mRemap[i] = NO_INDEX;
+	}
+	mProxies.resize(count);
+
+	//Keeps the order, so the endpoints stay sorted
+	size_t end = 0;
+	for(size_t i = 0; i < mEndpoints.size(); i++) {
+		uint32_t proxy = mRemap[mEndpoints[i].proxy];
+		if(proxy != NO_INDEX) {
+			mEndpoints[end] = mEndpoints[i];
+			mEndpoints[end].proxy = proxy;
+			end++;
+		}
+	}
+	mEndpoints.resize(end);
+	mRemovedCount = 0;
+}
+
+size_t SweepAndPrune::insertNew() {
+	size_t added = mNewElements.size();
+	for(QuadTreeNodePtr elem : mNewElements) {
+		uint32_t proxy = (uint32_t) mProxies.size();
+		elem->mProxy = proxy;
+		mProxies.push_back(Proxy {elem, NO_INDEX});
+		mEndpoints.push_back(Endpoint {0, proxy, true});
+		mEndpoints.push_back(Endpoint {0, proxy, false});
+	}
+	mNewElements.clear();
+	return added;
+}
+
+void SweepAndPrune::updateEndpoints() {
+	for(Endpoint& ep : mEndpoints) {
+		QuadTreeNodePtr elem = mProxies[ep.proxy].elem;
+		ep.value = ep.isMin ? elem->getPosition().x - elem->getSize() : elem->getPosition().x + elem->getSize();
+	}
+}
+
+void SweepAndPrune::sort() {
+	for(size_t i = 1; i < mEndpoints.size(); i++) {
+		if(!(mEndpoints[i] < mEndpoints[i - 1]))
+			continue;
+		Endpoint ep = mEndpoints[i];
+		size_t j = i;
+		do {
+			mEndpoints[j] = mEndpoints[j - 1];
+			j--;
+		} while(j > 0 && ep < mEndpoints[j - 1]);
+		mEndpoints[j] = ep;
+	}
+}
+
+void SweepAndPrune::queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor) {
+	//The proxies are only changed by the simulation thread, added elements are queued
+	size_t begin = mFound.size();
+	for(const Proxy& proxy : mProxies)
+		if(proxy.elem && matches(proxy.elem, from, to, types))
+			mFound.push_back(proxy.elem);
+	visitFound(begin, visitor);
+}
@@ -0,0 +1,70 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_SWEEPANDPRUNE_H
+#define SERVER_SWEEPANDPRUNE_H
+
+#include "GlobalDefs.h"
+#include "Broadphase.h"
+
+/*
+ * Sweep and prune along the x axis. The endpoint array is kept between the checks
+ * and only insertion sorted again, most elements barely move within one tick so this is close to O(n).
+ * New elements are queued and merged at the start of the next check,
+ * removed elements are dropped from the arrays in one pass.
+ */
+class SweepAndPrune : public Broadphase {
+private:
+	struct Endpoint {
+		double value;
+		uint32_t proxy;
+		bool isMin;
+
+		//Start points first, touching elements may still intersect
+		bool operator <(const Endpoint& other) const {
+			return value < other.value || (value == other.value && isMin && !other.isMin);
+		}
+	};
+	struct Proxy {
+		QuadTreeNodePtr elem;
+		uint32_t active;
+	};
+
+	vector<Proxy> mProxies;
+	vector<Endpoint> mEndpoints;
+	vector<uint32_t> mActive;
+	vector<uint32_t> mRemap;
+	vector<QuadTreeNodePtr> mNewElements;
+	size_t mRemovedCount = 0;
+
+	mutex mMutex;
+
+public:
+	SweepAndPrune();
+
+	virtual bool add(QuadTreeNodePtr elem);
+	virtual bool remove(QuadTreeNodePtr elem);
+	virtual void update(QuadTreeNodePtr elem) {} //Endpoints are updated on every check
+
+	virtual size_t getElementCount() const { return mProxies.size() - mRemovedCount + mNewElements.size(); }
+	virtual size_t getChildCount() const { return mEndpoints.size(); }
+
+	virtual const char* getName() const { return "sweepandprune"; }
+
+	//Scans all elements, the endpoints are only sorted along x
+	virtual void queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor);
+
+protected:
+	virtual void findCollisions();
+
+private:
+	void compact();
+	size_t insertNew();
+	void updateEndpoints();
+	void sort();
+	void sweep(TaskResult& result);
+};
+
+
+#endif //SERVER_SWEEPANDPRUNE_H
@@ -0,0 +1,91 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "SweepIndex.h"
+#include "QuadTree.h"
+
+SweepIndex::SweepIndex(const Vector& mSize, double mCellSize) :
+		mSize(mSize), mCellSize(mCellSize)
+{
+	mColumns = (uint32_t) max(1., ceil(mSize.x / mCellSize));
+	mRows = (uint32_t) max(1., ceil(mSize.y / mCellSize));
+	mCells.resize(mColumns * mRows);
+}
+
+bool SweepIndex::insertSwept(const vector<QuadTreeNodePtr>& swept) {
+	for(uint32_t cell : mUsedCells)
+		mCells[cell].clear();
+	mUsedCells.clear();
+	mSweptCount = 0;
+
+	for(QuadTreeNodePtr elem : swept) {
+		if(elem->isDeleted() || !elem->isSwept()) continue;
+		Bounds bounds = getBounds(elem);
+		for(uint32_t y = bounds.minY; y <= bounds.maxY; y++) {
+			for(uint32_t x = bounds.minX; x <= bounds.maxX; x++) {
+				uint32_t cell = y * mColumns + x;
+				if(mCells[cell].empty())
+					mUsedCells.push_back(cell);
+				mCells[cell].push_back(Entry {elem, bounds.minX, bounds.minY});
+			}
+		}
+		mSweptCount++;
+	}
+	return mSweptCount > 0;
+}
+
+void SweepIndex::findCollisions() {
+	if(!mElements)
+		return;
+	const vector<QuadTreeNodePtr>& elements = *mElements;
+	runTasks((elements.size() + TASK_SIZE - 1) / TASK_SIZE, [this, &elements] (size_t task, TaskResult& result) {
+		size_t end = min(elements.size(), (task + 1) * TASK_SIZE);
+		for(size_t i = task * TASK_SIZE; i < end; i++)
+			query(elements[i], result);
+	});
+}
+
+void SweepIndex::query(QuadTreeNodePtr elem, TaskResult& result) {
+	//Not skipped by its mask, so pairs that can not interact are counted as dropped like in the other broadphases
+	if(elem->isDeleted())
+		return;
+	Bounds bounds = getBounds(elem);
+	for(uint32_t y = bounds.minY; y <= bounds.maxY; y++) {
+		for(uint32_t x = bounds.minX; x <= bounds.maxX; x++) {
+			for(const Entry& entry : mCells[y * mColumns + x]) {
+				//Both bounds cover several cells, only the first one they share reports the pair
+				if(max(entry.minX, bounds.minX) != x || max(entry.minY, bounds.minY) != y) continue;
+				QuadTreeNodePtr other = entry.elem;
+				//Two swept elements find each other, only one of them reports the pair
+				if(other == elem || (elem->isSwept() && other < elem)) continue;
+				if(other->isDeleted()) continue;
+				if(!elem->canCollide(other)) {
+					result.drop(elem->getCollisionType(), other->getCollisionType());
+					continue;
+				}
+				result.pairTests++;
+				//Intersecting at the end of the tick, already reported by the other broadphases
+				if(elem->intersect(other) || !elem->sweptIntersect(other)) continue;
+				result.pairs.push_back(CollisionPair {elem, other});
+			}
+		}
+	}
+}
+
+SweepIndex::Bounds SweepIndex::getBounds(QuadTreeNodePtr elem) const {
+	//The whole movement of the last tick expanded by the size
+	const Vector& end = elem->getPosition();
+	Vector start = end - elem->getSweep();
+	double size = elem->getSize();
+	return Bounds {
+		toCell(min(start.x, end.x) - size, mColumns), toCell(min(start.y, end.y) - size, mRows),
+		toCell(max(start.x, end.x) + size, mColumns), toCell(max(start.y, end.y) + size, mRows)
+	};
+}
+
+uint32_t SweepIndex::toCell(double pos, uint32_t count) const {
+	if(pos <= 0)
+		return 0;
+	return min((uint32_t) (pos / mCellSize), count - 1);
+}
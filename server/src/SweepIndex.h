@@ -0,0 +1,87 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_SWEEPINDEX_H
+#define SERVER_SWEEPINDEX_H
+
+#include "GlobalDefs.h"
+#include "Vector.h"
+#include "Broadphase.h"
+
+/*
+ * Continuous collision detection for elements that moved further than their own size in the
+ * last tick (see QuadTreeNode::setSweep), e.g. Shoots and boosted Balls. The other broadphases
+ * only test the positions at the end of the tick, so these could jump over smaller elements.
+ *
+ * The swept elements are put into a grid by the bounds of their whole movement every tick,
+ * then all elements are tested against the cells their own movement touches. Pairs that
+ * intersect at the end of the tick are skipped, the other broadphases already reported them.
+ */
+class SweepIndex : public Broadphase {
+private:
+	struct Entry {
+		QuadTreeNodePtr elem;
+		//First cell covered by the movement, a pair is only reported in the first shared cell
+		uint32_t minX;
+		uint32_t minY;
+	};
+	struct Bounds {
+		uint32_t minX;
+		uint32_t minY;
+		uint32_t maxX;
+		uint32_t maxY;
+	};
+	//Elements tested by one task
+	static const size_t TASK_SIZE = 256;
+
+	Vector mSize;
+	double mCellSize;
+	uint32_t mColumns;
+	uint32_t mRows;
+
+	vector<vector<Entry> > mCells;
+	//Cells that have to be cleared before the next check
+	vector<uint32_t> mUsedCells;
+	size_t mSweptCount = 0;
+
+	const vector<QuadTreeNodePtr>* mElements = NULL;
+
+public:
+	SweepIndex(const Vector& mSize, double mCellSize);
+
+	//Swept elements are collected every tick, nothing is stored between the checks
+	virtual bool add(QuadTreeNodePtr elem) { return false; }
+	virtual bool remove(QuadTreeNodePtr elem) { return false; }
+	virtual void update(QuadTreeNodePtr elem) {}
+	virtual void queryRect(const Vector& from, const Vector& to, uint32_t types, QueryVisitor visitor) {}
+
+	//Tests all elements against the swept ones
+	template<typename Visitor>
+	void doCollisionCheck(const vector<QuadTreeNodePtr>& swept, const vector<QuadTreeNodePtr>& elements, Visitor&& visitor) {
+		if(!insertSwept(swept))
+			return;
+		mElements = &elements;
+		Broadphase::doCollisionCheck(visitor);
+		mElements = NULL;
+	}
+
+	//Swept elements of the last check
+	virtual size_t getElementCount() const { return mSweptCount; }
+	virtual size_t getChildCount() const { return mCells.size(); }
+
+	virtual const char* getName() const { return "swept"; }
+
+protected:
+	virtual void findCollisions();
+
+private:
+	//Rebuilds the grid, returns false if there is no swept element
+	bool insertSwept(const vector<QuadTreeNodePtr>& swept);
+	void query(QuadTreeNodePtr elem, TaskResult& result);
+	Bounds getBounds(QuadTreeNodePtr elem) const;
+	uint32_t toCell(double pos, uint32_t count) const;
+};
+
+
+#endif //SERVER_SWEEPINDEX_H
@@ -0,0 +1,85 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(size_t threads) {
+	for(size_t i = 0; i < threads; i++)
+		mThreads.emplace_back(&WorkerPool::run, this);
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		lock_guard<mutex> _lock(mMutex);
+		mRunning = false;
+	}
+	mWakeup.notify_all();
+	for(std::thread& t : mThreads)
+		t.join();
+}
+
+WorkerPool& WorkerPool::get() {
+	static WorkerPool pool(max(std::thread::hardware_concurrency(), 1u) - 1);
+	return pool;
+}
+
+void WorkerPool::parallelFor(size_t count, size_t maxThreads, const function<void (size_t)>& func) {
+	if(maxThreads == 0 || maxThreads > getThreadCount())
+		maxThreads = getThreadCount();
+	maxThreads = min(maxThreads, count);
+	if(maxThreads <= 1) {
+		for(size_t i = 0; i < count; i++)
+			func(i);
+		return;
+	}
+
+	Job job;
+	job.func = &func;
+	job.count = count;
+	job.next = 0;
+	job.helpers = maxThreads - 1;
+	job.active = 0;
+	job.queued = true;
+	{
+		lock_guard<mutex> _lock(mMutex);
+		mJobs.push_back(&job);
+	}
+	mWakeup.notify_all();
+
+	work(job);
+
+	//No worker may join after this, then wait for the ones still running
+	unique_lock<mutex> _lock(mMutex);
+	if(job.queued)
+		mJobs.remove(&job);
+	mFinished.wait(_lock, [&job] { return job.active == 0; });
+}
+
+void WorkerPool::run() {
+	unique_lock<mutex> _lock(mMutex);
+	while(true) {
+		mWakeup.wait(_lock, [this] { return !mRunning || !mJobs.empty(); });
+		if(!mRunning)
+			return;
+
+		Job* job = mJobs.front();
+		job->active++;
+		if(--job->helpers == 0) {
+			mJobs.pop_front();
+			job->queued = false;
+		}
+
+		_lock.unlock();
+		work(*job);
+		_lock.lock();
+
+		if(--job->active == 0)
+			mFinished.notify_all();
+	}
+}
+
+void WorkerPool::work(Job& job) {
+	for(size_t i = job.next++; i < job.count; i = job.next++)
+		(*job.func)(i);
+}
@@ -0,0 +1,57 @@
+//
+// Created by agent on 17.10.26.
+//
+
+#ifndef SERVER_WORKERPOOL_H
+#define SERVER_WORKERPOOL_H
+
+#include "GlobalDefs.h"
+
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+
+/*
+ * Threads shared by all lobbies (one per core, the calling thread helps out).
+ * parallelFor hands out the indices of a job to the workers and returns once all of them are done.
+ * Several lobbies may run jobs at the same time.
+ */
+class WorkerPool {
+private:
+	struct Job {
+		const function<void (size_t)>* func;
+		size_t count;
+		std::atomic<size_t> next;
+		//Workers that may still join and workers currently running tasks, guarded by mMutex
+		size_t helpers;
+		size_t active;
+		bool queued;
+	};
+
+	vector<std::thread> mThreads;
+	list<Job*> mJobs;
+	bool mRunning = true;
+
+	mutex mMutex;
+	std::condition_variable mWakeup;
+	std::condition_variable mFinished;
+
+public:
+	WorkerPool(size_t threads);
+	~WorkerPool();
+
+	static WorkerPool& get();
+
+	//Number of threads that can work on one job, including the calling one
+	size_t getThreadCount() const { return mThreads.size() + 1; }
+
+	//Calls func for every index in [0, count) on up to maxThreads threads (0 = all)
+	void parallelFor(size_t count, size_t maxThreads, const function<void (size_t)>& func);
+
+private:
+	void run();
+	void work(Job& job);
+};
+
+
+#endif //SERVER_WORKERPOOL_H